@@ -0,0 +1,425 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "benchmark.h"
+#include "isoEngine.h"
+#include "particles.h"
+#include "jobs.h"
+#include "tileLayout.h"
+#include "softRenderer.h"
+#include "renderer.h"
+#include "world.h"
+
+#define BENCH_LAYOUT_BLOCK_SHIFT    5
+#define BENCH_LAYOUT_TILES_PER_RUN  (64*1024*1024)
+#define BENCH_ISO_POINTS            4096
+#define BENCH_ISO_ITERATIONS        4000
+#define BENCH_ISO_RANGE             2000
+#define BENCH_PARTICLE_CAPACITY     (128*1024)
+#define BENCH_PARTICLE_FRAMES       240
+#define BENCH_BLIT_FRAMES           200
+#define BENCH_BLIT_TILE_WIDTH       64
+#define BENCH_BLIT_TILE_HEIGHT      80
+
+static double getElapsedSeconds(Uint64 start)
+{
+    return (double)(SDL_GetPerformanceCounter()-start)/(double)SDL_GetPerformanceFrequency();
+}
+
+//walk the map the way drawIsoMap does: one screen row is one diagonal x+y
+#define ISO_WALK(width,height,indexExpr,map,sum)                                 \
+{                                                                                \
+    Uint32 d,x,y,firstX,lastX;                                                   \
+    for(d=0;d<(width)+(height)-1;++d){                                           \
+        firstX = d<(height) ? 0 : d-(height)+1;                                  \
+        lastX = d<(width) ? d : (width)-1;                                       \
+        for(x=firstX;x<=lastX;++x){                                              \
+            y = d-x;                                                             \
+            sum += map[indexExpr];                                               \
+        }                                                                        \
+    }                                                                            \
+}
+
+static double timeLayout(int layout,Uint8 *map,Uint32 width,int passes,Uint32 *checksum)
+{
+    int pass;
+    Uint32 sum = 0;
+    Uint32 blocksWide = width>>BENCH_LAYOUT_BLOCK_SHIFT;
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    for(pass=0;pass<passes;++pass){
+        if(layout==0){
+            ISO_WALK(width,width,y*width+x,map,sum);
+        }
+        else if(layout==1){
+            ISO_WALK(width,width,tiledIndex2D(x,y,BENCH_LAYOUT_BLOCK_SHIFT,blocksWide),map,sum);
+        }
+        else{
+            ISO_WALK(width,width,mortonEncode2D(x,y),map,sum);
+        }
+    }
+    *checksum = sum;
+    return getElapsedSeconds(start);
+}
+
+static void fillLayout(int layout,Uint8 *map,Uint32 width)
+{
+    Uint32 x,y,index;
+    Uint32 blocksWide = width>>BENCH_LAYOUT_BLOCK_SHIFT;
+
+    for(y=0;y<width;++y){
+        for(x=0;x<width;++x){
+            if(layout==0){
+                index = y*width+x;
+            }
+            else if(layout==1){
+                index = tiledIndex2D(x,y,BENCH_LAYOUT_BLOCK_SHIFT,blocksWide);
+            }
+            else{
+                index = mortonEncode2D(x,y);
+            }
+            map[index] = (Uint8)((x*7+y*13)%5);
+        }
+    }
+}
+
+int benchmarkTileLayout()
+{
+    static const char *layoutNames[3] = {"row-major","tiled 32x32","morton"};
+    Uint32 widths[3] = {1024,4096,16384};
+    int i,layout,passes;
+    double seconds,rowMajorSeconds = 0;
+    Uint32 checksum,rowMajorChecksum = 0;
+    Uint8 *map;
+
+    fprintf(stdout,"Isometric traversal over a square map, tiles read in drawIsoMap order\n");
+    fprintf(stdout,"%-12s %8s %12s %10s\n","layout","width","ns/tile","speedup");
+
+    for(i=0;i<3;++i){
+        map = malloc((size_t)widths[i]*widths[i]);
+        if(map == NULL){
+            fprintf(stderr,"Benchmark error: could not allocate a %ux%u map\n",widths[i],widths[i]);
+            return 1;
+        }
+        passes = BENCH_LAYOUT_TILES_PER_RUN/(widths[i]*widths[i]);
+        if(passes<1){
+            passes = 1;
+        }
+
+        for(layout=0;layout<3;++layout){
+            fillLayout(layout,map,widths[i]);
+            seconds = timeLayout(layout,map,widths[i],passes,&checksum);
+            if(layout==0){
+                rowMajorSeconds = seconds;
+                rowMajorChecksum = checksum;
+            }
+            else if(checksum != rowMajorChecksum){
+                fprintf(stderr,"Benchmark error: %s layout read different tiles than row-major!\n",layoutNames[layout]);
+                free(map);
+                return 1;
+            }
+            fprintf(stdout,"%-12s %8u %12.3f %9.2fx\n",layoutNames[layout],widths[i],
+                    seconds*1e9/((double)widths[i]*widths[i]*passes),rowMajorSeconds/seconds);
+        }
+        free(map);
+    }
+    return 0;
+}
+
+//written after every timed loop so the compiler can not throw the work away
+volatile float benchmarkSink;
+
+static void reportTransformRate(const char *name,Uint64 start,int numTransforms,float sink)
+{
+    double seconds = getElapsedSeconds(start);
+    benchmarkSink = sink;
+    fprintf(stdout,"%-36s %10.2f M transforms/s (%.2f ns each)\n",name,
+            numTransforms/seconds/1e6,seconds*1e9/numTransforms);
+}
+
+//one timed pass over the points per variant, summed up in an int so the float adds of the sink do not hide the divides
+#define BENCH_TILE_MATH(name,tileSize,points,sink,expr)                         \
+{                                                                                \
+    char fullName[64];                                                           \
+    int i,iteration;                                                             \
+    Uint64 start = SDL_GetPerformanceCounter();                                  \
+    for(iteration=0;iteration<BENCH_ISO_ITERATIONS;++iteration){                 \
+        for(i=0;i<BENCH_ISO_POINTS;++i){                                         \
+            sink += expr;                                                        \
+        }                                                                        \
+    }                                                                            \
+    snprintf(fullName,sizeof(fullName),"%s %d",name,tileSize);                   \
+    reportTransformRate(fullName,start,BENCH_ISO_POINTS*BENCH_ISO_ITERATIONS,sink); \
+}
+
+//GetTileCoordinates(...) as it was before it went through ISO_TILE_DIV_TRUNC
+static void getTileCoordinatesFloat(point2DT *point,point2DT *point2DCoord)
+{
+    point2DCoord->x = (int)(point->x/(float)TILESIZE);
+    point2DCoord->y = (int)(point->y/(float)TILESIZE);
+}
+
+//both tile coordinate versions are called through this, so neither is inlined into the timed loop
+static void (*volatile tileCoordinates)(point2DT *point,point2DT *point2DCoord);
+
+//the functions the game calls against the float divides they replaced, and the runtime tile size
+//against the shifts and masks a fixed tile size compiles to
+static float benchmarkTileMath(int tileSize,int shift,point2DT *points)
+{
+    static worldT world;
+    int startX,startY,endX,endY;
+    point2DT result;
+    int sink = 0;
+
+#ifdef ISO_FIXED_TILESIZE
+    if(tileSize != ISO_FIXED_TILESIZE){
+        return 0;
+    }
+#endif
+    InitIsoEngine(&world.isoEngine,tileSize);
+    world.zoomLevel = 1.0;
+    world.viewWidth = WINDOW_WIDTH;
+    world.viewHeight = WINDOW_HEIGHT;
+    tileCoordinates = getTileCoordinatesFloat;
+    BENCH_TILE_MATH("tile coordinates float divide",tileSize,points,sink,
+                    (tileCoordinates(&points[i],&result),(int)result.x+(int)result.y))
+    tileCoordinates = GetTileCoordinates;
+    BENCH_TILE_MATH("GetTileCoordinates",tileSize,points,sink,
+                    (tileCoordinates(&points[i],&result),(int)result.x+(int)result.y))
+    BENCH_TILE_MATH("worldGetViewRange",tileSize,points,sink,
+                    (world.mapScroll2Dpos = points[i],worldGetViewRange(&world,&startX,&startY,&endX,&endY),startX+startY))
+    BENCH_TILE_MATH("worldGetTileAtScreenPoint",tileSize,points,sink,
+                    (world.isoEngine.scrollX = points[i].y,worldGetTileAtScreenPoint(&world,&points[i],&result),(int)result.x))
+    BENCH_TILE_MATH("tile div+mod generic",tileSize,points,sink,
+                    IsoTileDivGeneric((int)points[i].x)+IsoTileModGeneric((int)points[i].y))
+    BENCH_TILE_MATH("tile div+mod shift",tileSize,points,sink,
+                    ISO_TILE_DIV_SHIFT(points[i].x,shift)+ISO_TILE_MOD_MASK(points[i].y,tileSize))
+    return sink;
+}
+
+int benchmarkIsoEngine()
+{
+    static point2DT points[BENCH_ISO_POINTS];
+    isoEngineT isoEngine;
+    point2DT point,result;
+    int i,iteration;
+    int numTransforms = BENCH_ISO_POINTS*BENCH_ISO_ITERATIONS;
+    float sink = 0;
+    Uint64 start;
+
+    InitIsoEngine(&isoEngine,32);
+    for(i=0;i<BENCH_ISO_POINTS;++i){
+        points[i].x = (rand()%(2*BENCH_ISO_RANGE))-BENCH_ISO_RANGE;
+        points[i].y = (rand()%(2*BENCH_ISO_RANGE))-BENCH_ISO_RANGE;
+    }
+
+    start = SDL_GetPerformanceCounter();
+    for(iteration=0;iteration<BENCH_ISO_ITERATIONS;++iteration){
+        for(i=0;i<BENCH_ISO_POINTS;++i){
+            point = points[i];
+            Convert2dToIso(&point);
+            sink += point.x;
+        }
+    }
+    reportTransformRate("Convert2dToIso",start,numTransforms,sink);
+
+    start = SDL_GetPerformanceCounter();
+    for(iteration=0;iteration<BENCH_ISO_ITERATIONS;++iteration){
+        for(i=0;i<BENCH_ISO_POINTS;++i){
+            point = points[i];
+            ConvertIsoTo2D(&point);
+            sink += point.x;
+        }
+    }
+    reportTransformRate("ConvertIsoTo2D",start,numTransforms,sink);
+
+    start = SDL_GetPerformanceCounter();
+    for(iteration=0;iteration<BENCH_ISO_ITERATIONS;++iteration){
+        for(i=0;i<BENCH_ISO_POINTS;++i){
+            GetTileCoordinates(&points[i],&result);
+            sink += result.x;
+        }
+    }
+    reportTransformRate("GetTileCoordinates",start,numTransforms,sink);
+
+    sink += benchmarkTileMath(32,5,points);
+    sink += benchmarkTileMath(64,6,points);
+    InitIsoEngine(&isoEngine,32);
+
+    start = SDL_GetPerformanceCounter();
+    for(iteration=0;iteration<BENCH_ISO_ITERATIONS;++iteration){
+        for(i=0;i<BENCH_ISO_POINTS;++i){
+            isoEngine.scrollX = points[i].x;
+            isoEngine.scrollY = points[i].y;
+            convertIsoCameraToCartesian(&isoEngine,&result);
+            sink += result.x;
+        }
+    }
+    reportTransformRate("convertIsoCameraToCartesian",start,numTransforms,sink);
+
+    start = SDL_GetPerformanceCounter();
+    for(iteration=0;iteration<BENCH_ISO_ITERATIONS;++iteration){
+        for(i=0;i<BENCH_ISO_POINTS;++i){
+            convertCartesianCameraToIsometric(&isoEngine,&points[i]);
+            sink += isoEngine.scrollX;
+        }
+    }
+    reportTransformRate("convertCartesianCameraToIsometric",start,numTransforms,sink);
+
+    return 0;
+}
+
+int benchmarkParticles()
+{
+    particleSystemT particles;
+    memArenaT frameArena;
+    isoEngineT isoEngine;
+    textureT atlas;
+    SDL_Rect sourceRect = {28,12,4,4};
+    SDL_Color color = {0xff,0xff,0xff,0xff};
+    int frame,tileX,tileY;
+    double updateSeconds = 0,drawSeconds = 0;
+    int liveParticles = 0;
+    Uint64 start;
+
+    InitIsoEngine(&isoEngine,32);
+    isoEngine.scrollX = 600;
+    memset(&atlas,0,sizeof(textureT));
+    atlas.width = 320;
+    atlas.height = 80;
+    atlas.softImage = -1;
+    atlas.resource = -1;
+
+    if(jobSystemInit(-1)==0 || particleSystemInit(&particles,BENCH_PARTICLE_CAPACITY)==0 ||
+       memArenaInit(&frameArena,BENCH_PARTICLE_CAPACITY*(4*sizeof(SDL_Vertex)+8)+1024,"frame arena")==0){
+        return 1;
+    }
+    //enough emitters on screen to keep roughly 100k particles alive
+    for(tileY=0;tileY<8;++tileY){
+        for(tileX=0;tileX<8;++tileX){
+            particleAddTileEmitter(&particles,tileX*2,tileY*2,1400,&sourceRect,color);
+        }
+    }
+
+    for(frame=0;frame<BENCH_PARTICLE_FRAMES;++frame){
+        memArenaReset(&frameArena);
+        start = SDL_GetPerformanceCounter();
+        particleSystemUpdate(&particles,1.0f/60.0f);
+        if(frame>=BENCH_PARTICLE_FRAMES/2){
+            updateSeconds += getElapsedSeconds(start);
+        }
+
+        //without a renderer the batch submit is a no-op, this times the sort and vertex build
+        start = SDL_GetPerformanceCounter();
+        particleSystemDraw(&particles,&isoEngine,&atlas,1.0f,&frameArena);
+        if(frame>=BENCH_PARTICLE_FRAMES/2){
+            drawSeconds += getElapsedSeconds(start);
+            liveParticles += particles.numParticles;
+        }
+    }
+
+    frame = BENCH_PARTICLE_FRAMES-BENCH_PARTICLE_FRAMES/2;
+    fprintf(stdout,"particles alive (avg): %d, drawn last frame: %d\n",liveParticles/frame,particles.numDrawn);
+    fprintf(stdout,"update: %.3f ms/frame, depth sort + vertex build: %.3f ms/frame\n",
+            updateSeconds*1000/frame,drawSeconds*1000/frame);
+    fprintf(stdout,"job threads: %d\n",jobSystemNumThreads());
+    memArenaPrintStats(&frameArena);
+    memArenaClose(&frameArena);
+    particleSystemClose(&particles);
+    jobSystemClose();
+    return 0;
+}
+
+//a cube shaped tile like the ones in isotiles.png, with half transparent edges
+static void buildBenchmarkTile(Uint32 *pixels)
+{
+    int x,y,distance;
+    Uint32 alpha;
+
+    for(y=0;y<BENCH_BLIT_TILE_HEIGHT;++y){
+        for(x=0;x<BENCH_BLIT_TILE_WIDTH;++x){
+            if(y<16){
+                distance = abs(2*x+1-BENCH_BLIT_TILE_WIDTH)-(4*y+2);
+            }
+            else if(y>=BENCH_BLIT_TILE_HEIGHT-16){
+                distance = abs(2*x+1-BENCH_BLIT_TILE_WIDTH)-(4*(BENCH_BLIT_TILE_HEIGHT-1-y)+2);
+            }
+            else{
+                distance = 2*x<BENCH_BLIT_TILE_WIDTH ? -2*x : 2*x+2-2*BENCH_BLIT_TILE_WIDTH;
+            }
+            alpha = distance<-2 ? 0xff : (distance<=0 ? 0x80 : 0);
+            pixels[y*BENCH_BLIT_TILE_WIDTH+x] = (alpha<<24) | (((Uint32)x*4)<<16) | (((Uint32)y*3)<<8) | 0x40;
+        }
+    }
+}
+
+static double timeSoftRenderer(Uint32 *tilePixels,float scale,Uint32 *checksum)
+{
+    SDL_Rect clip = {0,0,BENCH_BLIT_TILE_WIDTH,BENCH_BLIT_TILE_HEIGHT};
+    SDL_Rect quad;
+    int frame,i,j;
+    int image = softRendererAddImage(tilePixels,BENCH_BLIT_TILE_WIDTH,BENCH_BLIT_TILE_HEIGHT,BENCH_BLIT_TILE_WIDTH*sizeof(Uint32));
+    int stepX = BENCH_BLIT_TILE_WIDTH*scale;
+    int stepY = BENCH_BLIT_TILE_WIDTH*scale/4;
+    Uint32 *pixels = softRendererGetPixels();
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    //the same back to front rows of overlapping tiles that drawIsoMap produces
+    quad.w = BENCH_BLIT_TILE_WIDTH*scale+1;
+    quad.h = BENCH_BLIT_TILE_HEIGHT*scale+1;
+    for(frame=0;frame<BENCH_BLIT_FRAMES;++frame){
+        softRendererClear(0x3b,0x3b,0x3b);
+        for(i=-4;i<WINDOW_HEIGHT/stepY+4;++i){
+            for(j=-1;j<WINDOW_WIDTH/stepX+1;++j){
+                quad.x = j*stepX+(i&1)*stepX/2;
+                quad.y = i*stepY;
+                softRendererBlit(image,&clip,&quad);
+            }
+        }
+    }
+
+    *checksum = 0;
+    for(i=0;i<WINDOW_WIDTH*WINDOW_HEIGHT;++i){
+        *checksum = *checksum*31+pixels[i];
+    }
+    return getElapsedSeconds(start);
+}
+
+int benchmarkSoftRenderer()
+{
+    int kernels[] = {SOFT_KERNEL_SCALAR,SOFT_KERNEL_SSE2,SOFT_KERNEL_AVX2};
+    float scales[] = {1.0f,1.5f};
+    Uint32 *tilePixels = malloc(BENCH_BLIT_TILE_WIDTH*BENCH_BLIT_TILE_HEIGHT*sizeof(Uint32));
+    Uint32 checksum,reference[2];
+    double seconds;
+    int i,j;
+    int failed = 0;
+
+    if(tilePixels == NULL){
+        return 1;
+    }
+    buildBenchmarkTile(tilePixels);
+
+    for(i=0;i<3;++i){
+        for(j=0;j<2;++j){
+            if(softRendererInit(NULL,WINDOW_WIDTH,WINDOW_HEIGHT,kernels[i])==0){
+                free(tilePixels);
+                return 1;
+            }
+            seconds = timeSoftRenderer(tilePixels,scales[j],&checksum);
+            //every kernel has to produce the exact same frame as the scalar one
+            if(i==0){
+                reference[j] = checksum;
+            }
+            if(checksum != reference[j]){
+                failed = 1;
+            }
+            fprintf(stdout,"%-6s zoom %.1f: %.3f ms/frame%s\n",softRendererKernelName(),scales[j],
+                    seconds*1000/BENCH_BLIT_FRAMES,checksum==reference[j] ? "" : " (frame differs from scalar!)");
+            softRendererClose();
+        }
+    }
+    free(tilePixels);
+    return failed;
+}
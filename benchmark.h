@@ -0,0 +1,9 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+int benchmarkTileLayout();
+int benchmarkIsoEngine();
+int benchmarkParticles();
+int benchmarkSoftRenderer();
+
+#endif // BENCHMARK_H_
@@ -0,0 +1,140 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "headless.h"
+#include "world.h"
+#include "jobs.h"
+
+#define HEADLESS_MAP_MEMORY_BUDGET  (64*1024)
+#define HEADLESS_INPUT_PERIOD       30
+#define HEADLESS_MODE_PERIOD        600
+//the window size of the game, so a headless world sees as much of the map as a player does
+#define HEADLESS_VIEW_WIDTH         1200
+#define HEADLESS_VIEW_HEIGHT        720
+
+typedef struct headlessWorldT
+{
+    worldT world;
+    worldInputT input;
+    Uint32 randomState;
+    Uint32 checksum;
+}headlessWorldT;
+
+typedef struct headlessRunT
+{
+    headlessWorldT *worlds;
+    int numTicks;
+}headlessRunT;
+
+static Uint32 nextRandom(headlessWorldT *headless)
+{
+    Uint32 state = headless->randomState;
+    state ^= state<<13;
+    state ^= state>>17;
+    state ^= state<<5;
+    headless->randomState = state;
+    return state;
+}
+
+//a made up player that holds a direction for a while and keeps the mouse near the edges
+static void makeUpInput(headlessWorldT *headless)
+{
+    Uint32 random = nextRandom(headless);
+
+    headless->input.moveUp = random&1;
+    headless->input.moveDown = (random>>1)&1;
+    headless->input.moveLeft = (random>>2)&1;
+    headless->input.moveRight = (random>>3)&1;
+    headless->input.hasMouse = 1;
+    headless->input.mouseX = (random>>4)&1 ? 0 : HEADLESS_VIEW_WIDTH;
+    headless->input.mouseY = (random>>5)&1 ? 0 : HEADLESS_VIEW_HEIGHT;
+    if(((random>>6)&7) == 0){
+        headless->input.mouseX = HEADLESS_VIEW_WIDTH/2;
+    }
+}
+
+static void stepWorlds(void *data,int start,int end)
+{
+    headlessRunT *run = (headlessRunT*)data;
+    headlessWorldT *headless;
+    worldT *world;
+    int i,tick,tile;
+
+    for(i=start;i<end;++i){
+        headless = &run->worlds[i];
+        world = &headless->world;
+        for(tick=0;tick<run->numTicks;++tick){
+            if(tick%HEADLESS_INPUT_PERIOD == 0){
+                makeUpInput(headless);
+            }
+            if(tick%HEADLESS_MODE_PERIOD == HEADLESS_MODE_PERIOD-1){
+                worldToggleGameMode(world);
+            }
+            worldStep(world,&headless->input);
+
+            //fold the state into a checksum so two runs can be compared
+            //TILESIZE is unsigned, without the cast a negative position would wrap around to a huge tile index
+            tile = mapStreamGetTile(&world->mapStream,(int)floor(world->charPoint.x/(int)TILESIZE),
+                                    (int)floor(world->charPoint.y/(int)TILESIZE));
+            headless->checksum = headless->checksum*31 + (Uint32)tile;
+            headless->checksum = headless->checksum*31 + (Uint32)(int)world->charPoint.x;
+            headless->checksum = headless->checksum*31 + (Uint32)(int)world->charPoint.y;
+            headless->checksum = headless->checksum*31 + (Uint32)world->isoEngine.scrollX;
+        }
+    }
+}
+
+int runHeadless(int numWorlds,int numTicks)
+{
+    headlessRunT run;
+    jobCounterT counter;
+    Uint64 start;
+    double seconds;
+    Uint32 checksum = 0;
+    int numResident = 0;
+    int i;
+
+    if(numWorlds<=0 || numTicks<=0)
+    {
+        fprintf(stderr,"Error in runHeadless(...): bad parameters!\n");
+        return 1;
+    }
+    run.numTicks = numTicks;
+    run.worlds = calloc(numWorlds,sizeof(headlessWorldT));
+    if(run.worlds == NULL || jobSystemInit(-1)==0){
+        fprintf(stderr,"Error in runHeadless(...): could not create %d worlds!\n",numWorlds);
+        free(run.worlds);
+        return 1;
+    }
+
+    //the maps only live in memory, so there is no disk I/O and no thread per world
+    for(i=0;i<numWorlds;++i){
+        if(worldInit(&run.worlds[i].world,HEADLESS_VIEW_WIDTH,HEADLESS_VIEW_HEIGHT,HEADLESS_MAP_MEMORY_BUDGET,NULL)==0){
+            numWorlds = i;
+            break;
+        }
+        run.worlds[i].randomState = i*2654435761u+1;
+    }
+
+    //every world is independent, one job per world steps it through all the ticks
+    start = SDL_GetPerformanceCounter();
+    jobCounterInit(&counter);
+    jobParallelFor(stepWorlds,&run,numWorlds,1,&counter);
+    jobWait(&counter);
+    seconds = (double)(SDL_GetPerformanceCounter()-start)/SDL_GetPerformanceFrequency();
+
+    for(i=0;i<numWorlds;++i){
+        checksum = checksum*31+run.worlds[i].checksum;
+        numResident += mapStreamNumResidentChunks(&run.worlds[i].world.mapStream);
+        worldClose(&run.worlds[i].world);
+    }
+    fprintf(stdout,"%d worlds x %d ticks in %.3f s on %d threads\n",numWorlds,numTicks,seconds,jobSystemNumThreads());
+    fprintf(stdout,"%.0f world ticks per second, %.1f resident chunks per world, checksum %08x\n",
+            seconds>0 ? numWorlds*(double)numTicks/seconds : 0.0,numWorlds>0 ? (float)numResident/numWorlds : 0.0f,checksum);
+
+    free(run.worlds);
+    jobSystemClose();
+    return 0;
+}
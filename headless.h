@@ -0,0 +1,6 @@
+#ifndef HEADLESS_H_
+#define HEADLESS_H_
+
+int runHeadless(int numWorlds,int numTicks);
+
+#endif // HEADLESS_H_
@@ -0,0 +1,49 @@
+/*
+ *   The benchmarks, built on its own by the Benchmarks target. None of them opens a window
+ *   or loads assets.
+ *
+ *   Usage: isoBenchmarks [layout] [iso] [particles] [blit]
+ *   Without arguments every benchmark is run.
+ */
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include "benchmark.h"
+
+#define NUM_BENCHMARKS  4
+
+typedef struct benchmarkT
+{
+    const char *name;
+    int (*run)();
+}benchmarkT;
+
+static benchmarkT benchmarks[NUM_BENCHMARKS] = {
+    {"layout",benchmarkTileLayout},
+    {"iso",benchmarkIsoEngine},
+    {"particles",benchmarkParticles},
+    {"blit",benchmarkSoftRenderer}
+};
+
+int main(int argc, char *argv[])
+{
+    int i,j;
+    int result = 0;
+
+    if(argc<2){
+        for(i=0;i<NUM_BENCHMARKS;++i){
+            fprintf(stdout,"\n%s:\n",benchmarks[i].name);
+            result |= benchmarks[i].run();
+        }
+        return result;
+    }
+    for(j=1;j<argc;++j){
+        for(i=0;i<NUM_BENCHMARKS && strcmp(benchmarks[i].name,argv[j])!=0;++i);
+        if(i==NUM_BENCHMARKS){
+            fprintf(stderr,"Error, there is no benchmark called %s\n",argv[j]);
+            return 1;
+        }
+        result |= benchmarks[i].run();
+    }
+    return result;
+}
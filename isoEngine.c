@@ -3,6 +3,10 @@
 #include <math.h>
 #include "isoEngine.h"
 
+#ifndef ISO_FIXED_TILESIZE
+unsigned int TILESIZE;
+#endif
+
 void setupRect(SDL_Rect *rect,int x,int y,int w,int h)
 {
     rect->x = x;
@@ -11,25 +15,35 @@ void setupRect(SDL_Rect *rect,int x,int y,int w,int h)
     rect->h = h;
 }
 
-void InitIsoEngine(isoEngineT *isoEngine, int tileSizeInPixels)
+int InitIsoEngine(isoEngineT *isoEngine, int tileSizeInPixels)
 {
     if(isoEngine == NULL)
     {
         fprintf(stderr,"Error in InitIsoEngine(...): isoEngine parameter is NULL!\n");
-        return;
+        return 0;
     }
 
+#ifdef ISO_FIXED_TILESIZE
+    //the tile maths of this build is made for one tile size only
+    if(tileSizeInPixels>0 && tileSizeInPixels != ISO_FIXED_TILESIZE){
+        fprintf(stderr,"Error in InitIsoEngine(...): this build only has %d pixel tiles, not %d!\n",
+                ISO_FIXED_TILESIZE,tileSizeInPixels);
+        return 0;
+    }
+#else
     if(tileSizeInPixels<=0){
         TILESIZE = 32;
     }
     else{
         TILESIZE = tileSizeInPixels;
     }
+#endif
 
     isoEngine->mapHeight = 0;
     isoEngine->mapWidth = 0;
     isoEngine->scrollX = 0;
     isoEngine->scrollY = 0;
+    return 1;
 }
 
 void IsoEngineSetMapSize(isoEngineT *isoEngine,int width, int height)
@@ -58,14 +72,34 @@ void ConvertIsoTo2D(point2DT *point)
     point->y = tmpY;
 }
 
-void GetTileCoordinates(point2DT *point,point2DT *point2DCoord)
+int IsoTileDivGeneric(int value)
+{
+    int tileSize = (int)TILESIZE;
+    int tile = value/tileSize;
+
+    //C rounds towards zero, one tile less on the negative side
+    if(value%tileSize<0){
+        tile--;
+    }
+    return tile;
+}
+
+int IsoTileModGeneric(int value)
 {
-    float tempX = (float)point->x / (float)TILESIZE;
-    float tempY = (float)point->y / (float)TILESIZE;
+    int tileSize = (int)TILESIZE;
+    int offset = value%tileSize;
 
-    //convert back to integer
-    point2DCoord->x = (int)tempX;
-    point2DCoord->y = (int)tempY;
+    if(offset<0){
+        offset += tileSize;
+    }
+    return offset;
+}
+
+//truncating to a whole pixel first does not change the tile, which is rounded towards zero like it always was
+void GetTileCoordinates(point2DT *point,point2DT *point2DCoord)
+{
+    point2DCoord->x = ISO_TILE_DIV_TRUNC(point->x);
+    point2DCoord->y = ISO_TILE_DIV_TRUNC(point->y);
 }
 
 void convertIsoCameraToCartesian(isoEngineT *isoEngine,point2DT *cartesianCamPos)
@@ -2,7 +2,33 @@
 #define ISOENGINE_H_
 #include <SDL2/SDL.h>
 
-unsigned int TILESIZE;
+//tile index and position inside the tile of a pixel, rounded down on the negative side as well.
+//ISO_TILE_DIV_TRUNC rounds the tile index towards zero instead, like the float divides it replaced.
+//Relies on >> of a negative 32 bit int being an arithmetic shift, which it is on every compiler we build with
+#define ISO_TILE_DIV_SHIFT(value,shift)     ((int)(value)>>(shift))
+#define ISO_TILE_MOD_MASK(value,size)       ((int)(value)&((size)-1))
+
+//build with -DISO_FIXED_TILESIZE=32 (or 64) to make the tile size a constant for the whole game,
+//the tile divides and modulos then turn into shifts and masks (the Release Tile32 target does this)
+#ifdef ISO_FIXED_TILESIZE
+#if ISO_FIXED_TILESIZE == 32
+#define ISO_FIXED_TILESHIFT 5
+#elif ISO_FIXED_TILESIZE == 64
+#define ISO_FIXED_TILESHIFT 6
+#else
+#error "ISO_FIXED_TILESIZE has to be 32 or 64"
+#endif
+#define TILESIZE            ((unsigned int)ISO_FIXED_TILESIZE)
+#define ISO_TILE_DIV(value) ISO_TILE_DIV_SHIFT(value,ISO_FIXED_TILESHIFT)
+#define ISO_TILE_MOD(value) ISO_TILE_MOD_MASK(value,ISO_FIXED_TILESIZE)
+#define ISO_TILE_DIV_TRUNC(value) ISO_TILE_DIV_SHIFT((int)(value)+(((int)(value)>>31)&(ISO_FIXED_TILESIZE-1)),ISO_FIXED_TILESHIFT)
+#else
+extern unsigned int TILESIZE;
+#define ISO_TILE_DIV(value) IsoTileDivGeneric((int)(value))
+#define ISO_TILE_MOD(value) IsoTileModGeneric((int)(value))
+//an integer divide is slower than the float one when the tile size is not known at compile time
+#define ISO_TILE_DIV_TRUNC(value) ((int)((float)(value)/(float)TILESIZE))
+#endif
 
 typedef struct isoEngineT
 {
@@ -19,11 +45,14 @@ typedef struct point2DT
 }point2DT;
 
 void setupRect(SDL_Rect *rect,int x,int y,int w,int h);
-void InitIsoEngine(isoEngineT *isoEngine, int tileSizeInPixels);
+int InitIsoEngine(isoEngineT *isoEngine, int tileSizeInPixels);
 void IsoEngineSetMapSize(isoEngineT *isoEngine,int width, int height);
 void Convert2dToIso(point2DT *point);
 void ConvertIsoTo2D(point2DT *point);
 void GetTileCoordinates(point2DT *point,point2DT *point2DCoord);
+//the runtime tile size versions of ISO_TILE_DIV and ISO_TILE_MOD, they work for any tile size
+int IsoTileDivGeneric(int value);
+int IsoTileModGeneric(int value);
 
 void convertIsoCameraToCartesian(isoEngineT *isoEngine,point2DT *cartesianCamPos);
 void convertCartesianCameraToIsometric(isoEngineT *isoEngine,point2DT *cartesianCamPos);
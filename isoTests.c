@@ -0,0 +1,231 @@
+/*
+ *   Checks of the isometric maths, built on its own by the Tests target.
+ *   Needs no window and no assets, the exit code is 0 when every check passed.
+ */
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "isoEngine.h"
+
+#define CHECK_ISO_RANGE             2000
+
+static int reportCheck(const char *name,int failures,int numChecked,float maxErrorX,float maxErrorY)
+{
+    fprintf(stdout,"%s %-44s checked:%9d failed:%7d max error x:%5.2f y:%5.2f\n",
+            failures==0?"PASS":"FAIL",name,numChecked,failures,maxErrorX,maxErrorY);
+    return failures==0;
+}
+
+static void trackError(float error,float *maxError)
+{
+    error = fabsf(error);
+    if(error>*maxError){
+        *maxError = error;
+    }
+}
+
+//GetTileCoordinates(...) and ISO_TILE_DIV/ISO_TILE_MOD against the float divide they replace,
+//and the shift and mask versions of a power of two tile size against the runtime tile size versions
+static int checkTileMath(int tileSize,int shift)
+{
+    isoEngineT isoEngine;
+    point2DT point,result;
+    char name[64];
+    int x,y,pixel;
+    int failures = 0,numChecked = 0;
+    int divFailures = 0,numDivChecked = 0;
+
+#ifdef ISO_FIXED_TILESIZE
+    if(tileSize != ISO_FIXED_TILESIZE){
+        fprintf(stdout,"SKIP tile maths for %d pixel tiles, the tile size is fixed to %d in this build\n",
+                tileSize,ISO_FIXED_TILESIZE);
+        return 1;
+    }
+#endif
+    if(InitIsoEngine(&isoEngine,tileSize)==0){
+        return 0;
+    }
+    //quarter pixels and both sides of zero, where truncation and floor() part ways
+    for(y=-CHECK_ISO_RANGE*4;y<=CHECK_ISO_RANGE*4;y+=13){
+        for(x=-CHECK_ISO_RANGE*4;x<=CHECK_ISO_RANGE*4;++x){
+            point.x = x*0.25f;
+            point.y = y*0.25f;
+            GetTileCoordinates(&point,&result);
+            if(result.x != (int)(point.x/tileSize) || result.y != (int)(point.y/tileSize)){
+                failures++;
+            }
+            numChecked++;
+        }
+    }
+    snprintf(name,sizeof(name),"tile coordinates == float divide, %d px",tileSize);
+    failures = reportCheck(name,failures,numChecked,0,0) ? 0 : 1;
+
+    //a fractional pixel is rounded down to a whole one before it is split into tile and offset
+    for(x=-CHECK_ISO_RANGE*4;x<=CHECK_ISO_RANGE*4;++x){
+        pixel = (int)floorf(x*0.25f);
+        if(IsoTileDivGeneric(pixel) != (int)floorf(x*0.25f/tileSize) ||
+           IsoTileModGeneric(pixel) != pixel-(int)floorf(x*0.25f/tileSize)*tileSize ||
+           ISO_TILE_DIV_SHIFT(pixel,shift) != IsoTileDivGeneric(pixel) ||
+           ISO_TILE_MOD_MASK(pixel,tileSize) != IsoTileModGeneric(pixel) ||
+           ISO_TILE_DIV(pixel) != IsoTileDivGeneric(pixel) || ISO_TILE_MOD(pixel) != IsoTileModGeneric(pixel)){
+            divFailures++;
+        }
+        numDivChecked++;
+    }
+    snprintf(name,sizeof(name),"tile div/mod, shift == generic == floor, %d px",tileSize);
+    return reportCheck(name,divFailures,numDivChecked,0,0) && failures == 0;
+}
+
+static int checkIsoEngine()
+{
+    static const float zoomLevels[9] = {1.0,1.25,1.5,1.75,2.0,2.25,2.5,2.75,3.0};
+    isoEngineT isoEngine;
+    point2DT point,result,camera;
+    int x,y,z,tileX,tileY;
+    int failures,numChecked,numLossy;
+    int allPassed = 1;
+    float maxErrorX,maxErrorY;
+    float tileSize,scrollX,scrollY;
+
+    InitIsoEngine(&isoEngine,32);
+
+    //Convert2dToIso truncates (x+y)/2, so odd sums lose half a pixel that comes back as a 1 pixel error
+    failures = numChecked = numLossy = 0;
+    maxErrorX = maxErrorY = 0;
+    for(y=-CHECK_ISO_RANGE;y<=CHECK_ISO_RANGE;y+=3){
+        for(x=-CHECK_ISO_RANGE;x<=CHECK_ISO_RANGE;x+=3){
+            point.x = x;
+            point.y = y;
+            Convert2dToIso(&point);
+            ConvertIsoTo2D(&point);
+            trackError(point.x-x,&maxErrorX);
+            trackError(point.y-y,&maxErrorY);
+            if(point.x != x || point.y != y){
+                numLossy++;
+                if(((x+y)&1) == 0 || fabsf(point.x-x)>1 || fabsf(point.y-y)>1){
+                    failures++;
+                }
+            }
+            numChecked++;
+        }
+    }
+    allPassed &= reportCheck("2D->iso->2D, exact for even x+y, else <=1px",failures,numChecked,maxErrorX,maxErrorY);
+    fprintf(stdout,"     %d of %d points (%.1f%%) did not round trip exactly\n",numLossy,numChecked,100.0f*numLossy/numChecked);
+
+    //the game keeps the cartesian camera as the master copy, it must survive a trip through the iso camera
+    failures = numChecked = 0;
+    maxErrorX = maxErrorY = 0;
+    for(y=-CHECK_ISO_RANGE;y<=CHECK_ISO_RANGE;++y){
+        for(x=-CHECK_ISO_RANGE;x<=CHECK_ISO_RANGE;x+=7){
+            camera.x = x;
+            camera.y = y;
+            convertCartesianCameraToIsometric(&isoEngine,&camera);
+            convertIsoCameraToCartesian(&isoEngine,&result);
+            trackError(result.x-camera.x,&maxErrorX);
+            trackError(result.y-camera.y,&maxErrorY);
+            if(result.x != camera.x || result.y != camera.y){
+                failures++;
+            }
+            numChecked++;
+        }
+    }
+    allPassed &= reportCheck("camera cart->iso->cart, exact",failures,numChecked,maxErrorX,maxErrorY);
+
+    //CenterMap can leave half pixels in the cartesian camera, those are dropped by the (int) casts
+    failures = numChecked = 0;
+    maxErrorX = maxErrorY = 0;
+    for(y=-CHECK_ISO_RANGE;y<=CHECK_ISO_RANGE;++y){
+        for(x=-CHECK_ISO_RANGE;x<=CHECK_ISO_RANGE;x+=7){
+            camera.x = x+0.5f;
+            camera.y = y+0.5f;
+            convertCartesianCameraToIsometric(&isoEngine,&camera);
+            convertIsoCameraToCartesian(&isoEngine,&result);
+            trackError(result.x-camera.x,&maxErrorX);
+            trackError(result.y-camera.y,&maxErrorY);
+            if(fabsf(result.x-camera.x)>1.5f || fabsf(result.y-camera.y)>1.5f){
+                failures++;
+            }
+            numChecked++;
+        }
+    }
+    allPassed &= reportCheck("camera cart->iso->cart half pixels, <=1.5px",failures,numChecked,maxErrorX,maxErrorY);
+
+    failures = numChecked = 0;
+    maxErrorX = maxErrorY = 0;
+    for(y=-CHECK_ISO_RANGE;y<=CHECK_ISO_RANGE;++y){
+        for(x=-CHECK_ISO_RANGE;x<=CHECK_ISO_RANGE;x+=7){
+            isoEngine.scrollX = x;
+            isoEngine.scrollY = y;
+            convertIsoCameraToCartesian(&isoEngine,&camera);
+            convertCartesianCameraToIsometric(&isoEngine,&camera);
+            trackError(isoEngine.scrollX-x,&maxErrorX);
+            trackError(isoEngine.scrollY-y,&maxErrorY);
+            if(abs(isoEngine.scrollX-x)>1 || abs(isoEngine.scrollY-y)>1){
+                failures++;
+            }
+            numChecked++;
+        }
+    }
+    allPassed &= reportCheck("camera iso->cart->iso, <=1px",failures,numChecked,maxErrorX,maxErrorY);
+
+    //GetTileCoordinates truncates towards zero, which only agrees with floor() on the positive side
+    failures = numChecked = numLossy = 0;
+    for(x=-CHECK_ISO_RANGE;x<=CHECK_ISO_RANGE;++x){
+        point.x = x;
+        point.y = x;
+        GetTileCoordinates(&point,&result);
+        if(result.x != floorf(point.x/TILESIZE) || result.y != floorf(point.y/TILESIZE)){
+            if(x>=0){
+                failures++;
+            }
+            numLossy++;
+        }
+        numChecked++;
+    }
+    allPassed &= reportCheck("tile coordinates == floor() for x,y >= 0",failures,numChecked,0,0);
+    fprintf(stdout,"     %d of %d points land in the neighbouring tile on the negative side\n",numLossy,numChecked);
+
+    //a tile centre pushed through the camera and the iso projection must come back to the same tile
+    for(z=0;z<9;++z){
+        char name[64];
+        failures = numChecked = 0;
+        maxErrorX = maxErrorY = 0;
+        tileSize = TILESIZE*zoomLevels[z];
+        for(scrollY=-CHECK_ISO_RANGE;scrollY<=CHECK_ISO_RANGE;scrollY+=97){
+            for(scrollX=-CHECK_ISO_RANGE;scrollX<=CHECK_ISO_RANGE;scrollX+=89){
+                for(tileY=0;tileY<64;tileY+=3){
+                    for(tileX=0;tileX<64;tileX+=3){
+                        point.x = (tileX+0.5f)*tileSize + scrollX;
+                        point.y = (tileY+0.5f)*tileSize + scrollY;
+                        Convert2dToIso(&point);
+                        ConvertIsoTo2D(&point);
+                        point.x = (point.x-scrollX)/zoomLevels[z];
+                        point.y = (point.y-scrollY)/zoomLevels[z];
+                        GetTileCoordinates(&point,&result);
+                        trackError(result.x-tileX,&maxErrorX);
+                        trackError(result.y-tileY,&maxErrorY);
+                        if(result.x != tileX || result.y != tileY){
+                            failures++;
+                        }
+                        numChecked++;
+                    }
+                }
+            }
+        }
+        snprintf(name,sizeof(name),"tile pick round trip at zoom %.2f",zoomLevels[z]);
+        allPassed &= reportCheck(name,failures,numChecked,maxErrorX,maxErrorY);
+    }
+
+    //the shifts and masks of a fixed tile size have to give exactly what the runtime tile size does
+    allPassed &= checkTileMath(32,5);
+    allPassed &= checkTileMath(64,6);
+    InitIsoEngine(&isoEngine,32);
+
+    return allPassed ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    return checkIsoEngine();
+}
@@ -18,10 +18,22 @@
  *            When part 3 comes, two videos will be released at the same time, part 2.5 (refactoring code) and
  *            part 3 - Covering multi-layer map rendering, collision handling and some more stuff (not decided upon yet)
  *
+ *   Needs SDL 2.0.18 or newer (SDL_RenderGeometry) and SDL_image.
+ *   The checks and the benchmarks are their own executables, built by the Tests and Benchmarks targets.
+ *
  *   Usage:
+ *   Start with --software to composite the frame on the CPU instead of the SDL renderer
+ *   Start with --headless [worlds] [ticks] to step that many worlds without a window and time them
+ *   Start with --late-input to sample the input right before drawing instead of before the sleep
+ *   Start with --budget <textures|surfaces|chunks|sprites|lod>=<KB> to cap the memory of a category
+ *   Start with --load to continue from the latest save instead of the map as it was left
  *   Space bar -  toggle between Overview mode / Object focus mode
+ *   C - toggle culling of tiles hidden behind nearer tiles
+ *   L - toggle late input sampling (prints the input latency measured so far)
+ *   M - print the memory used per category
+ *   F5 - save the map, the character and the camera (written in the background)
  *   Move the character with w,a,s,d
- *   Zoom in and out with the mouse wheel
+ *   Zoom in and out with the mouse wheel (far enough out to see the whole map)
  *
  *   Overview mode:
  *   Left click - center map to tile under mouse
@@ -29,6 +41,7 @@
  *
  *   Object focus mode:
  *   Left click on the map for "tile picking" (shows the selected tile up in the top left corner of the screen)
+ *   Right click on the map to change the tile under the mouse
  *
  ******************************************************************************************************************
  *
@@ -48,30 +61,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 #include "initclose.h"
 #include "renderer.h"
 #include "texture.h"
 #include "isoEngine.h"
-
-#define PLAYER_DIR_UP_LEFT      0
-#define PLAYER_DIR_UP           1
-#define PLAYER_DIR_UP_RIGHT     2
-#define PLAYER_DIR_RIGHT        3
-#define PLAYER_DIR_DOWN_RIGHT   4
-#define PLAYER_DIR_DOWN         5
-#define PLAYER_DIR_DOWN_LEFT    6
-#define PLAYER_DIR_LEFT         7
+#include "mapStream.h"
+#include "particles.h"
+#include "jobs.h"
+#include "memArena.h"
+#include "occlusion.h"
+#include "softRenderer.h"
+#include "world.h"
+#include "headless.h"
+#include "mapLod.h"
+#include "latency.h"
+#include "resources.h"
 
 #define NUM_ISOMETRIC_TILES 5
 #define NUM_CHARACTER_SPRITES 8
-#define MAP_HEIGHT 64
-#define MAP_WIDTH 64
-
-#define GAME_MODE_OVERVIEW          0
-#define GAME_MODE_OBJECT_FOCUS      1
-#define NUM_GAME_MODES              2
-
-int worldTest[MAP_HEIGHT][MAP_WIDTH];
+#define MAP_MEMORY_BUDGET (1024*1024)
+#define MAP_CHUNK_DIRECTORY "data"
+#define PARTICLE_CAPACITY (128*1024)
+#define FRAME_ARENA_SIZE (16*1024*1024)
+#define SPRITE_CACHE_BUDGET (8*1024*1024)
 
 typedef struct gameT
 {
@@ -79,15 +92,20 @@ typedef struct gameT
     int loopDone;
     SDL_Rect mouseRect;
     point2DT mousePoint;
-    point2DT mapScroll2Dpos;
-    int mapScrolllSpeed;
-    isoEngineT isoEngine;
     int lastTileClicked;
-    float zoomLevel;
-    point2DT tilePos;
-    point2DT charPoint;
-    int charDirection;
-    int gameMode;
+    worldT world;
+    worldInputT input;
+    particleSystemT particles;
+    int charEmitter;
+    int tileEmitter;
+    point2DT lastCharPoint;
+    Uint32 lastTicks;
+    memArenaT frameArena;
+    occlusionT occlusion;
+    mapLodT mapLod;
+    latencyTraceT latency;
+    int lateInput;
+    int loadSave;
 }gameT;
 
 gameT game;
@@ -96,8 +114,6 @@ textureT characterTex;
 SDL_Rect tilesRects[NUM_ISOMETRIC_TILES];
 SDL_Rect charRects[NUM_CHARACTER_SPRITES];
 
-void scrollMapWithMouse();
-
 void initTileClip()
 {
     int x=0,y=0;
@@ -125,70 +141,84 @@ void initCharClip()
 void writeCoords()
 {
     fprintf(stdout,"\rmap x:%d,map y:%d, iso x:%d, iso y:%d                                     ",
-            (int)game.mapScroll2Dpos.x,(int)game.mapScroll2Dpos.y,(int)game.isoEngine.scrollX,(int)game.isoEngine.scrollY);
+            (int)game.world.mapScroll2Dpos.x,(int)game.world.mapScroll2Dpos.y,(int)game.world.isoEngine.scrollX,(int)game.world.isoEngine.scrollY);
 }
 
-void generateMap()
+int initParticles()
 {
-    int x,y;
-    int paintTile=0;
-    for(y=0;y<MAP_HEIGHT;y+=2)
-    {
-        for(x=0;x<MAP_HEIGHT;x+=2)
-        {
-            worldTest[y][x] = 1;
-            worldTest[y+1][x] = 1;
-            worldTest[y][x+1] = 1;
-            worldTest[y+1][x+1] = 1;
-            paintTile = rand()%10;
-
-            if(paintTile>8)
-            {
-                if(y<MAP_HEIGHT-4 && x<MAP_WIDTH-4){
-                    worldTest[y][x] = 4;
-                    worldTest[y+1][x] = 4;
-                    worldTest[y][x+1] = 4;
-                    worldTest[y+1][x+1] = 4;
-                }
-            }
-            if(paintTile==7){
-                if(y<MAP_HEIGHT-4 && x<MAP_WIDTH-4){
-                    worldTest[y][x] = 3;
-                    worldTest[y+1][x] = 3;
-                    worldTest[y][x+1] = 3;
-                    worldTest[y+1][x+1] = 3;
-                }
-            }
-        }
-    }
+    SDL_Rect dustRect = {64+28,12,8,8};
+    SDL_Color dustColor = {0xc8,0xb4,0x8c,0xc0};
+
+    if(particleSystemInit(&game.particles,PARTICLE_CAPACITY)==0){
+        return 0;
+    }
+    //kick up dust around the feet of the character while it walks
+    game.charEmitter = particleAddEntityEmitter(&game.particles,&game.world.charPoint,80,&dustRect,dustColor);
+    particleSetEmitterOffset(&game.particles,game.charEmitter,99.5,96.5);
+    particleSetEmitterActive(&game.particles,game.charEmitter,0);
+    game.tileEmitter = -1;
+    game.lastCharPoint = game.world.charPoint;
+    return 1;
 }
 
 void init()
 {
-    int tileSize = 32;
+    int loadedSave;
+
     game.loopDone = 0;
+
+    //one worker per core, the main thread makes up the last one
+    if(jobSystemInit(-1)==0){
+        fprintf(stderr,"Error, could not start the job system\n");
+        exit(1);
+    }
+
+    //everything that only lives for one frame is allocated from here
+    if(memArenaInit(&game.frameArena,FRAME_ARENA_SIZE,"frame arena")==0){
+        exit(1);
+    }
     initTileClip();
     initCharClip();
-    InitIsoEngine(&game.isoEngine,tileSize);
-    IsoEngineSetMapSize(&game.isoEngine,16,16);
-    generateMap();
-    game.isoEngine.scrollX = 0;
-    game.isoEngine.scrollY = 0;
-    game.mapScroll2Dpos.x = 0;
-    game.mapScroll2Dpos.y = 0;
-    game.mapScrolllSpeed = 6;
+    if(worldInit(&game.world,WINDOW_WIDTH,WINDOW_HEIGHT,MAP_MEMORY_BUDGET,MAP_CHUNK_DIRECTORY)==0){
+        fprintf(stderr,"Error, could not create the world\n");
+        exit(1);
+    }
+    memset(&game.input,0,sizeof(worldInputT));
     game.lastTileClicked = -1;
-    game.zoomLevel = 1.0;
-    game.charPoint.x = 0;
-    game.charPoint.y = 0;
-    game.charDirection = PLAYER_DIR_DOWN;
-    game.gameMode = GAME_MODE_OVERVIEW;
+
+    //has to happen before anything reads the map, the LOD pyramid below included
+    loadedSave = 0;
+    if(game.loadSave){
+        loadedSave = worldLoad(&game.world);
+        if(loadedSave==0){
+            fprintf(stderr,"Warning, could not load the save, starting with the map as it was left\n");
+        }
+    }
+
+    //built with the job system, so it has to come after jobSystemInit(...).
+    //A loaded save rewrote the chunk files, so the pyramid kept from the last run no longer matches
+    if(mapLodInit(&game.mapLod,&game.world.mapStream,!loadedSave)==0){
+        fprintf(stderr,"Error, could not build the map LOD pyramid\n");
+        exit(1);
+    }
+    fprintf(stdout,"map LOD: %d levels, %d KB\n",game.mapLod.numLevels,mapLodSizeInBytes(&game.mapLod)/1024);
+
+    if(initParticles()==0){
+        fprintf(stderr,"Error, could not create the particle system\n");
+        exit(1);
+    }
+    game.lastTicks = SDL_GetTicks();
 
     if(loadTexture(&tilesTex,"data/isotiles.png")==0){
         fprintf(stderr,"Error, could not load texture: data/isotiles.png\n");
         exit(1);
     }
 
+    //without the masks every tile is simply drawn, so this is not fatal
+    if(occlusionInit(&game.occlusion,"data/isotiles.png",tilesRects,NUM_ISOMETRIC_TILES)==0){
+        fprintf(stderr,"Warning, tile occlusion culling is disabled\n");
+    }
+
     if(loadTexture(&characterTex,"data/character.png")==0){
         fprintf(stderr,"Error, could not load texture: data/character.png\n");
         exit(1);
@@ -197,22 +227,107 @@ void init()
 
 void drawIsoMouse()
 {
-    int modulusX = TILESIZE*game.zoomLevel;
-    int modulusY = TILESIZE*game.zoomLevel;
-    int correctX =(((int)game.mapScroll2Dpos.x)%modulusX)*2;
-    int correctY = ((int)game.mapScroll2Dpos.y)%modulusY;
+    int modulusX = SDL_max(TILESIZE*game.world.zoomLevel,1);
+    int modulusY = SDL_max(TILESIZE*game.world.zoomLevel,1);
+    int correctX =(((int)game.world.mapScroll2Dpos.x)%modulusX)*2;
+    int correctY = ((int)game.world.mapScroll2Dpos.y)%modulusY;
 
-    game.mousePoint.x = (game.mouseRect.x/TILESIZE) * TILESIZE;
-    game.mousePoint.y = (game.mouseRect.y/TILESIZE) * TILESIZE;
+    //snap to the tile grid, a shift and a mask when the tile size is fixed at compile time
+    game.mousePoint.x = game.mouseRect.x - ISO_TILE_MOD(game.mouseRect.x);
+    game.mousePoint.y = game.mouseRect.y - ISO_TILE_MOD(game.mouseRect.y);
 
     //For every other x position on the map
-    if(((int)game.mousePoint.x/TILESIZE)%2){
+    if(ISO_TILE_DIV(game.mousePoint.x)&1){
         //Move the mouse down by half a tile so we can
         //pick isometric tiles on that row as well.
         game.mousePoint.y+=TILESIZE*0.5;
     }
-    textureRenderXYClipScale(&tilesTex,(game.zoomLevel*game.mousePoint.x)-correctX,
-                             (game.zoomLevel*game.mousePoint.y)+correctY,&tilesRects[0],game.zoomLevel);
+    textureRenderXYClipScale(&tilesTex,(game.world.zoomLevel*game.mousePoint.x)-correctX,
+                             (game.world.zoomLevel*game.mousePoint.y)+correctY,&tilesRects[0],game.world.zoomLevel);
+}
+
+void drawTileList(occlusionTileT *tiles,int numTiles,float scale)
+{
+    int i;
+    occlusionCull(&game.occlusion,tiles,numTiles,scale,&game.frameArena);
+    for(i=0;i<numTiles;++i){
+        if(tiles[i].visible){
+            textureRenderXYClipScale(&tilesTex,tiles[i].x,tiles[i].y,&tilesRects[tiles[i].tile],scale);
+        }
+    }
+}
+
+//below zoom level 1.0 a cell of the LOD pyramid is drawn as one tile, so a screen costs about the same
+//number of tiles whether it shows a few hundred map tiles or the whole map
+void drawIsoMapLod(isoEngineT *isoEngine)
+{
+    int level = 0;
+    int cellX,cellY,diagonal,tile;
+    int cellsPerSide;
+    int minX,minY,maxX,maxY;
+    float cellSize,scale;
+    point2DT point;
+    point2DT corners[4] = {{0,0},{WINDOW_WIDTH,0},{0,WINDOW_HEIGHT},{WINDOW_WIDTH,WINDOW_HEIGHT}};
+    occlusionTileT *tiles;
+    int numTiles = 0;
+    int i;
+
+    //pick the level where a cell is at least as big as a tile at zoom level 1.0
+    while(level<game.mapLod.numLevels-1 && game.world.zoomLevel*(1<<level)<1.0){
+        level++;
+    }
+    cellsPerSide = 1<<level;
+    scale = game.world.zoomLevel*cellsPerSide;
+    cellSize = scale*TILESIZE;
+
+    //the screen corners bound the visible cells, the padding covers the height of the tile sprites
+    minX = minY = game.mapLod.width[0];
+    maxX = maxY = -1;
+    for(i=0;i<4;++i){
+        point = corners[i];
+        ConvertIsoTo2D(&point);
+        point.x = (point.x-isoEngine->scrollX)/cellSize;
+        point.y = (point.y-isoEngine->scrollY)/cellSize;
+        minX = SDL_min(minX,(int)floor(point.x));
+        minY = SDL_min(minY,(int)floor(point.y));
+        maxX = SDL_max(maxX,(int)ceil(point.x));
+        maxY = SDL_max(maxY,(int)ceil(point.y));
+    }
+    minX = SDL_max(minX-3,0);
+    minY = SDL_max(minY-3,0);
+    maxX = SDL_min(maxX+1,game.mapLod.width[level]-1);
+    maxY = SDL_min(maxY+1,game.mapLod.height[level]-1);
+    if(minX>maxX || minY>maxY){
+        return;
+    }
+
+    tiles = memArenaAlloc(&game.frameArena,(maxX-minX+1)*(maxY-minY+1)*sizeof(occlusionTileT));
+
+    //walk the diagonals from the back to the front, the same order drawIsoMap(...) draws in
+    for(diagonal=minX+minY;diagonal<=maxX+maxY;++diagonal){
+        for(cellX=SDL_max(minX,diagonal-maxY);cellX<=SDL_min(maxX,diagonal-minY);++cellX){
+            cellY = diagonal-cellX;
+            tile = mapLodGetCell(&game.mapLod,level,cellX,cellY);
+            if(tile == MAP_LOD_EMPTY){
+                continue;
+            }
+            point.x = (cellX*cellSize) + isoEngine->scrollX;
+            point.y = (cellY*cellSize) + isoEngine->scrollY;
+            Convert2dToIso(&point);
+            if(tiles == NULL){
+                textureRenderXYClipScale(&tilesTex,point.x,point.y,&tilesRects[tile],scale);
+                continue;
+            }
+            tiles[numTiles].x = point.x;
+            tiles[numTiles].y = point.y;
+            tiles[numTiles].tile = tile;
+            numTiles++;
+        }
+    }
+    if(tiles == NULL){
+        return;
+    }
+    drawTileList(tiles,numTiles,scale);
 }
 
 void drawIsoMap(isoEngineT *isoEngine)
@@ -221,207 +336,165 @@ void drawIsoMap(isoEngineT *isoEngine)
     int x,y;
     int tile = 4;
     point2DT point;
+    int startX,startY,endX,endY;
+    occlusionTileT *tiles;
+    int numTiles = 0;
+    float tileStep;
 
-    int startX = -3/game.zoomLevel +(game.mapScroll2Dpos.x/game.zoomLevel/TILESIZE)*2;
-    int startY = -20/game.zoomLevel + abs((game.mapScroll2Dpos.y/game.zoomLevel/TILESIZE))*2;
-    int numTilesInWidth = ((WINDOW_WIDTH/TILESIZE)/game.zoomLevel);
-    int numTilesInHeight = ((WINDOW_HEIGHT/TILESIZE)/game.zoomLevel)*2;
+    if(game.world.zoomLevel<1.0){
+        drawIsoMapLod(isoEngine);
+        return;
+    }
+    worldGetViewRange(&game.world,&startX,&startY,&endX,&endY);
 
-    for(i=startY;i<startY+numTilesInHeight+26;++i){
-        for(j=startX;j<startX+numTilesInWidth+5;++j){
+    //collect the tiles first so the ones hidden behind nearer tiles can be culled before drawing
+    tiles = memArenaAlloc(&game.frameArena,(endY-startY)*(endX-startX)*sizeof(occlusionTileT));
 
-            //only draw when both x & y is equal, so we skip here
-            if((j&1) != (i&1)){
-                continue;
-            }
+    //multiplying by a power of two tile size is exact, so this is the same as x*zoom*TILESIZE per tile
+    tileStep = game.world.zoomLevel*TILESIZE;
+
+    for(i=startY;i<endY;++i){
+        //only draw when both x & y is equal, so every other j is skipped
+        for(j=startX+((startX^i)&1);j<endX;j+=2){
             x = (i+j)/2;
             y = (i-j)/2;
 
-            if(x>=0 && y>=0 && x<MAP_WIDTH && y<MAP_HEIGHT){
-                tile = worldTest[y][x];
-                point.x = ((x*game.zoomLevel *TILESIZE) + isoEngine->scrollX);
-                point.y = ((y*game.zoomLevel *TILESIZE) + isoEngine->scrollY);
+            //tiles that are still on their way in from the disk are skipped this frame
+            tile = mapStreamGetTile(&game.world.mapStream,x,y);
+            if(tile != MAP_TILE_NOT_LOADED){
+                point.x = (x*tileStep) + isoEngine->scrollX;
+                point.y = (y*tileStep) + isoEngine->scrollY;
                 Convert2dToIso(&point);
-                textureRenderXYClipScale(&tilesTex,point.x,point.y,&tilesRects[tile],game.zoomLevel);
+                if(tiles == NULL){
+                    textureRenderXYClipScale(&tilesTex,point.x,point.y,&tilesRects[tile],game.world.zoomLevel);
+                    continue;
+                }
+                tiles[numTiles].x = point.x;
+                tiles[numTiles].y = point.y;
+                tiles[numTiles].tile = tile;
+                numTiles++;
             }
         }
     }
+    if(tiles == NULL){
+        return;
+    }
+    drawTileList(tiles,numTiles,game.world.zoomLevel);
     /*
     //loop through the map
     for(i=0;i<isoEngine->mapHeight;++i)
     {
         for(j=0;j<isoEngine->mapWidth;++j)
         {
-            point.x = (j *game.zoomLevel *TILESIZE) + isoEngine->scrollX;
-            point.y = (i *game.zoomLevel *TILESIZE) + isoEngine->scrollY;
+            point.x = (j *game.world.zoomLevel *TILESIZE) + isoEngine->scrollX;
+            point.y = (i *game.world.zoomLevel *TILESIZE) + isoEngine->scrollY;
 
-            tile = worldTest[i][j];
+            tile = mapStreamGetTile(&game.world.mapStream,j,i);
 
             Convert2dToIso(&point);
 
-            textureRenderXYClipScale(&tilesTex,point.x,point.y,&tilesRects[tile],game.zoomLevel);
+            textureRenderXYClipScale(&tilesTex,point.x,point.y,&tilesRects[tile],game.world.zoomLevel);
         }
     }*/
 }
 
-void getMouseTilePos(isoEngineT *isoEngine, point2DT *mouseTilePos)
+void getMouseTileClick()
 {
     point2DT point;
-    point2DT tileShift, mouse2IsoPOint;
-
-    if(isoEngine == NULL || mouseTilePos == NULL){
-        return;
-    }
-
-    int modulusX = TILESIZE*game.zoomLevel;
-    int modulusY = TILESIZE*game.zoomLevel;
-    int correctX =(((int)game.mapScroll2Dpos.x)%modulusX)*2;
-    int correctY = ((int)game.mapScroll2Dpos.y)%modulusY;
-
-    //copy mouse point
-    mouse2IsoPOint = game.mousePoint;
-    ConvertIsoTo2D(&mouse2IsoPOint);
-
-    //get tile coordinates
-    GetTileCoordinates(&mouse2IsoPOint,&point);
-
-    tileShift.x = correctX;
-    tileShift.y = correctY;
-    Convert2dToIso(&tileShift);
-
-    //check for fixing tile position when the y position is larger than 0
-    if(game.mapScroll2Dpos.y>0){
-        point.y -= (((float)isoEngine->scrollY-tileShift.y)/(float)TILESIZE)/game.zoomLevel;
-        point.y+=1;
-    }
-    else{
-        point.y -= (((float)isoEngine->scrollY-tileShift.y)/(float)TILESIZE)/game.zoomLevel;
-    }
-
-    //check for fixing tile position when the x position is larger than 0
-    if(game.mapScroll2Dpos.x>0)
+    worldGetTileAtScreenPoint(&game.world,&game.mousePoint,&point);
+    int tile = mapStreamGetTile(&game.world.mapStream,(int)point.x,(int)point.y);
+    SDL_Rect sparkRect = {28,12,4,4};
+    SDL_Color sparkColor = {0xff,0xe0,0x60,0xff};
+    if(tile != MAP_TILE_NOT_LOADED)
     {
-        point.x -= (((float)isoEngine->scrollX+(float)tileShift.x)/(float)TILESIZE)/game.zoomLevel;
-        point.x+=1;
-    }
-    else{
-        point.x -= (((float)isoEngine->scrollX+(float)tileShift.x)/(float)TILESIZE)/game.zoomLevel;
-    }
-    mouseTilePos->x = (int)point.x;
-    mouseTilePos->y = (int)point.y;
-}
+        game.lastTileClicked = tile;
 
-void getMouseTileClick(isoEngineT *isoEngine)
-{
-    point2DT point;
-    getMouseTilePos(isoEngine,&point);
-    if(point.x>=0 && point.y>=0 && point.x<MAP_WIDTH && point.y<MAP_HEIGHT)
-    {
-        game.lastTileClicked = worldTest[(int)point.y][(int)point.x];
+        //mark the picked tile with a fountain of sparks
+        particleRemoveEmitter(&game.particles,game.tileEmitter);
+        game.tileEmitter = particleAddTileEmitter(&game.particles,(int)point.x,(int)point.y,120,&sparkRect,sparkColor);
     }
 }
 
-void CenterMapToTileUnderMouse(isoEngineT *isoEngine)
-{
-    point2DT mouseIsoTilePos;
-
-    //calculate the offset of the center of the screen
-    int offsetX = WINDOW_WIDTH/game.zoomLevel/2;
-    int offsetY = WINDOW_HEIGHT/game.zoomLevel/2;
-
-    //get the tile under the mouse
-    getMouseTilePos(isoEngine,&mouseIsoTilePos);
-
-    game.tilePos.x = mouseIsoTilePos.x*TILESIZE;
-    game.tilePos.y = mouseIsoTilePos.y*TILESIZE;
-
-    //convert to isometric coordinates
-    Convert2dToIso(&mouseIsoTilePos);
-
-    //move the x position
-    game.mapScroll2Dpos.x = ((mouseIsoTilePos.x*TILESIZE)*game.zoomLevel)/2;
-    game.mapScroll2Dpos.x -= (offsetX*game.zoomLevel)/2;
-
-    //move the y position
-    game.mapScroll2Dpos.y = -((mouseIsoTilePos.y*TILESIZE)*game.zoomLevel);
-    game.mapScroll2Dpos.y += offsetY*game.zoomLevel;
-
-    //convert the map 2d camera to isometric camera
-    convertCartesianCameraToIsometric(isoEngine,&game.mapScroll2Dpos);
-}
-
-void CenterMap(isoEngineT *isoEngine,point2DT *objectPoint)
+//cycles the tile under the mouse, the LOD pyramid above it is patched right away
+void paintTileUnderMouse()
 {
-    point2DT pointPos = *objectPoint;
-
-    //calculate the offset of the center of the screen
-    int offsetX = WINDOW_WIDTH/game.zoomLevel/2;
-    int offsetY = WINDOW_HEIGHT/game.zoomLevel/2;
-
-    game.tilePos.x = objectPoint->x;
-    game.tilePos.y = objectPoint->y;
-
-    Convert2dToIso(&pointPos);
-
-    game.mapScroll2Dpos.x = floor((pointPos.x)*game.zoomLevel)/2;
-    game.mapScroll2Dpos.x -= offsetX*game.zoomLevel/2;
+    point2DT point;
+    int tile;
 
-    if(game.gameMode == GAME_MODE_OBJECT_FOCUS){
-        game.mapScroll2Dpos.x +=45*game.zoomLevel/2;
+    worldGetTileAtScreenPoint(&game.world,&game.mousePoint,&point);
+    tile = mapStreamGetTile(&game.world.mapStream,(int)point.x,(int)point.y);
+    if(tile == MAP_TILE_NOT_LOADED){
+        return;
     }
-
-    game.mapScroll2Dpos.y = -floor((pointPos.y)*game.zoomLevel);
-    game.mapScroll2Dpos.y += offsetY*game.zoomLevel;
-
-    if(game.gameMode == GAME_MODE_OBJECT_FOCUS){
-        game.mapScroll2Dpos.y -= 51*game.zoomLevel;
+    if(mapStreamSetTile(&game.world.mapStream,(int)point.x,(int)point.y,tile%(NUM_ISOMETRIC_TILES-1)+1)){
+        mapLodUpdateTile(&game.mapLod,(int)point.x,(int)point.y);
     }
-
-    convertCartesianCameraToIsometric(isoEngine,&game.mapScroll2Dpos);
 }
 
-
 void drawCharacter(isoEngineT *isoEngine)
 {
     point2DT point;
-    point.x = (int)(game.charPoint.x*game.zoomLevel)+ isoEngine->scrollX;
-    point.y = (int)(game.charPoint.y*game.zoomLevel)+ isoEngine->scrollY;
+    point.x = (int)(game.world.charPoint.x*game.world.zoomLevel)+ isoEngine->scrollX;
+    point.y = (int)(game.world.charPoint.y*game.world.zoomLevel)+ isoEngine->scrollY;
     Convert2dToIso(&point);
-    textureRenderXYClipScale(&characterTex,point.x,point.y,&charRects[game.charDirection],game.zoomLevel);
+    textureRenderXYClipScale(&characterTex,point.x,point.y,&charRects[game.world.charDirection],game.world.zoomLevel);
 }
 
 void draw()
 {
-    SDL_SetRenderDrawColor(getRenderer(),0x3b,0x3b,0x3b,0x00);
-    SDL_RenderClear(getRenderer());
+    if(softRendererIsActive()){
+        softRendererClear(0x3b,0x3b,0x3b);
+    }
+    else{
+        SDL_SetRenderDrawColor(getRenderer(),0x3b,0x3b,0x3b,0x00);
+        SDL_RenderClear(getRenderer());
+    }
 
-    drawIsoMap(&game.isoEngine);
-    drawCharacter(&game.isoEngine);
+    drawIsoMap(&game.world.isoEngine);
+    drawCharacter(&game.world.isoEngine);
+    particleSystemDraw(&game.particles,&game.world.isoEngine,&tilesTex,game.world.zoomLevel,&game.frameArena);
     drawIsoMouse();
 
     if(game.lastTileClicked!=-1){
         textureRenderXYClip(&tilesTex,0,0,&tilesRects[game.lastTileClicked]);
     }
 
+    softRendererPresent();
     SDL_RenderPresent(getRenderer());
-    //Don't be a CPU HOG!! :D
-    SDL_Delay(10);
+    latencyFramePresented(&game.latency);
 }
 
-void update()
+void updateParticles()
 {
-    SDL_GetMouseState(&game.mouseRect.x,&game.mouseRect.y);
-    game.mouseRect.x = game.mouseRect.x/game.zoomLevel;
-    game.mouseRect.y = game.mouseRect.y/game.zoomLevel;
+    Uint32 ticks = SDL_GetTicks();
+    float deltaTime = (ticks-game.lastTicks)/1000.0f;
+    game.lastTicks = ticks;
 
-    if(game.gameMode == GAME_MODE_OBJECT_FOCUS)
-    {
-        CenterMap(&game.isoEngine,&game.charPoint);
-    }
-    else if(game.gameMode == GAME_MODE_OVERVIEW){
-        scrollMapWithMouse();
+    //don't let a long stall fire off a burst of particles
+    if(deltaTime>0.1f){
+        deltaTime = 0.1f;
     }
 
+    particleSetEmitterActive(&game.particles,game.charEmitter,
+                             game.world.charPoint.x!=game.lastCharPoint.x || game.world.charPoint.y!=game.lastCharPoint.y);
+    game.lastCharPoint = game.world.charPoint;
+
+    particleSystemUpdate(&game.particles,deltaTime);
+}
+
+void update()
+{
+    SDL_GetMouseState(&game.mouseRect.x,&game.mouseRect.y);
+    latencyConsume(&game.latency,LATENCY_MOUSE_MOTION);
+    game.mouseRect.x = game.mouseRect.x/game.world.zoomLevel;
+    game.mouseRect.y = game.mouseRect.y/game.world.zoomLevel;
+    game.input.hasMouse = 1;
+    game.input.mouseX = game.mouseRect.x;
+    game.input.mouseY = game.mouseRect.y;
+
+    worldUpdateCamera(&game.world,&game.input);
+    worldUpdateMapStream(&game.world);
+    updateParticles();
 }
 
 void updateInput()
@@ -443,11 +516,26 @@ void updateInput()
                     break;
 
                     case SDLK_SPACE:
-                        game.gameMode++;
-                        if(game.gameMode>=NUM_GAME_MODES)
-                        {
-                            game.gameMode = GAME_MODE_OVERVIEW;
-                        }
+                        worldToggleGameMode(&game.world);
+                    break;
+
+                    case SDLK_c:
+                        game.occlusion.enabled = !game.occlusion.enabled;
+                        fprintf(stdout,"\ntile occlusion culling %s\n",game.occlusion.enabled ? "on" : "off");
+                    break;
+
+                    case SDLK_m:
+                        resourcePrintStats();
+                    break;
+
+                    case SDLK_F5:
+                        worldSave(&game.world);
+                    break;
+
+                    case SDLK_l:
+                        latencyPrintStats(&game.latency,game.lateInput ? "late input" : "default loop order");
+                        latencyReset(&game.latency);
+                        game.lateInput = !game.lateInput;
                     break;
 
                     default:break;
@@ -457,161 +545,162 @@ void updateInput()
             case SDL_MOUSEBUTTONDOWN:
                 if(game.event.button.button == SDL_BUTTON_LEFT)
                 {
-                    if(game.gameMode==GAME_MODE_OVERVIEW){
-                        CenterMapToTileUnderMouse(&game.isoEngine);
+                    if(game.world.gameMode==GAME_MODE_OVERVIEW){
+                        worldCenterMapToTileAtScreenPoint(&game.world,&game.mousePoint);
 
                     }
-                    if(game.gameMode == GAME_MODE_OBJECT_FOCUS){
-                        getMouseTileClick(&game.isoEngine);
+                    if(game.world.gameMode == GAME_MODE_OBJECT_FOCUS){
+                        getMouseTileClick();
                     }
                 }
+                if(game.event.button.button == SDL_BUTTON_RIGHT && game.world.gameMode == GAME_MODE_OBJECT_FOCUS){
+                    paintTileUnderMouse();
+                }
             break;
 
             case SDL_MOUSEWHEEL:
                 //If the user scrolled the mouse wheel up
                 if(game.event.wheel.y>=1)
                 {
-                    if(game.zoomLevel<3.0){
-                        game.zoomLevel+=0.25;
-                        if(game.gameMode==GAME_MODE_OVERVIEW)
-                        {
-                            CenterMap(&game.isoEngine,&game.tilePos);
-                        }
-                        if(game.gameMode == GAME_MODE_OBJECT_FOCUS){
-                            CenterMap(&game.isoEngine,&game.charPoint);
-                        }
-                    }
+                    worldZoom(&game.world,1);
                 }
                 //If the user scrolled the mouse wheel down
                 else{
-                    if(game.zoomLevel>1.0){
-                        game.zoomLevel-=0.25;
-                        if(game.gameMode==GAME_MODE_OVERVIEW)
-                        {
-                            CenterMap(&game.isoEngine,&game.tilePos);
-                        }
-                        if(game.gameMode == GAME_MODE_OBJECT_FOCUS){
-                            CenterMap(&game.isoEngine,&game.charPoint);
-                        }
-                    }
+                    worldZoom(&game.world,-1);
                 }
             break;
 
             default:break;
         }
     }
+    latencyConsume(&game.latency,LATENCY_INPUT_EVENTS);
 
-    if(keystate[SDL_SCANCODE_S] && !keystate[SDL_SCANCODE_D] && !keystate[SDL_SCANCODE_A] && !keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.x+=5;
-        game.charPoint.y+=5;
-        game.charDirection = PLAYER_DIR_DOWN;
-    }
-    else if(!keystate[SDL_SCANCODE_S] && !keystate[SDL_SCANCODE_D] && !keystate[SDL_SCANCODE_A] && keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.x-=5;
-        game.charPoint.y-=5;
-        game.charDirection = PLAYER_DIR_UP;
-    }
-    else if(!keystate[SDL_SCANCODE_S] && keystate[SDL_SCANCODE_D] && !keystate[SDL_SCANCODE_A] && keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.y-=5;
-        game.charDirection = PLAYER_DIR_UP_RIGHT;
-    }
-    else if(!keystate[SDL_SCANCODE_S] && !keystate[SDL_SCANCODE_D] && keystate[SDL_SCANCODE_A] && keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.x-=5;
-        game.charDirection = PLAYER_DIR_UP_LEFT;
-    }
-    else if(!keystate[SDL_SCANCODE_S] && keystate[SDL_SCANCODE_D] && !keystate[SDL_SCANCODE_A] && !keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.x+=3;
-        game.charPoint.y-=3;
-        game.charDirection = PLAYER_DIR_RIGHT;
-    }
-    else if(!keystate[SDL_SCANCODE_S] && !keystate[SDL_SCANCODE_D] && keystate[SDL_SCANCODE_A] && !keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.x-=3;
-        game.charPoint.y+=3;
-        game.charDirection = PLAYER_DIR_LEFT;
-    }
-    else if(keystate[SDL_SCANCODE_S] && !keystate[SDL_SCANCODE_D] && keystate[SDL_SCANCODE_A] && !keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.y+=5;
-        game.charDirection = PLAYER_DIR_DOWN_LEFT;
-    }
-    else if(keystate[SDL_SCANCODE_S] && keystate[SDL_SCANCODE_D] && !keystate[SDL_SCANCODE_A] && !keystate[SDL_SCANCODE_W])
-    {
-        game.charPoint.x+=5;
-        game.charDirection = PLAYER_DIR_DOWN_RIGHT;
-    }
+    game.input.moveUp = keystate[SDL_SCANCODE_W];
+    game.input.moveDown = keystate[SDL_SCANCODE_S];
+    game.input.moveLeft = keystate[SDL_SCANCODE_A];
+    game.input.moveRight = keystate[SDL_SCANCODE_D];
+    worldMoveCharacter(&game.world,&game.input);
 /*
     if(keystate[SDL_SCANCODE_W]){
 
-        game.mapScroll2Dpos.y+=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
+        game.world.mapScroll2Dpos.y+=game.world.mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&game.world.isoEngine,&game.world.mapScroll2Dpos);
     }
     if(keystate[SDL_SCANCODE_A]){
 
-        game.mapScroll2Dpos.x-=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
+        game.world.mapScroll2Dpos.x-=game.world.mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&game.world.isoEngine,&game.world.mapScroll2Dpos);
     }
     if(keystate[SDL_SCANCODE_S]){
 
-        game.mapScroll2Dpos.y-=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
+        game.world.mapScroll2Dpos.y-=game.world.mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&game.world.isoEngine,&game.world.mapScroll2Dpos);
 
     }
     if(keystate[SDL_SCANCODE_D]){
 
-        game.mapScroll2Dpos.x+=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
+        game.world.mapScroll2Dpos.x+=game.world.mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&game.world.isoEngine,&game.world.mapScroll2Dpos);
     }
 */
 }
 
-void scrollMapWithMouse()
+int main(int argc, char *argv[])
 {
-    int zoomEdgeX = (WINDOW_WIDTH*game.zoomLevel)-(WINDOW_WIDTH);
-    int zoomEdgeY = (WINDOW_HEIGHT*game.zoomLevel)-(WINDOW_HEIGHT);
-
-    if(game.mouseRect.x<2){
-        game.mapScroll2Dpos.x-=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
-    }
-    if(game.mouseRect.x>WINDOW_WIDTH-(zoomEdgeX/game.zoomLevel)-2){
-        game.mapScroll2Dpos.x+=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
+    int i;
+    int useSoftwareRenderer = 0;
+    int useLateInput = 0;
+    int category;
+    char *budget;
 
+    //no window and no renderer, just the simulation
+    if(argc>1 && strcmp(argv[1],"--headless")==0){
+        return runHeadless(argc>2 ? atoi(argv[2]) : 64,argc>3 ? atoi(argv[3]) : 10000);
     }
-    if(game.mouseRect.y<2){
-        game.mapScroll2Dpos.y+=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
 
-    }
-    if(game.mouseRect.y>WINDOW_HEIGHT-(zoomEdgeY/game.zoomLevel)-2){
-        game.mapScroll2Dpos.y-=game.mapScrolllSpeed;
-        convertCartesianCameraToIsometric(&game.isoEngine,&game.mapScroll2Dpos);
+    //scaled sprites are made again when they are needed, so they can live in a tight budget
+    resourceSetBudget(RESOURCE_SPRITE_CACHE,SPRITE_CACHE_BUDGET);
 
+    for(i=1;i<argc;++i){
+        if(strcmp(argv[i],"--budget")==0 && i+1<argc){
+            budget = strchr(argv[++i],'=');
+            if(budget != NULL){
+                *budget = '\0';
+            }
+            category = resourceFindCategory(argv[i]);
+            if(category<0 || budget == NULL){
+                fprintf(stderr,"Warning, ignoring budget %s\n",argv[i]);
+                continue;
+            }
+            resourceSetBudget(category,(Sint64)atoi(budget+1)*1024);
+        }
+        if(strcmp(argv[i],"--software")==0){
+            useSoftwareRenderer = 1;
+        }
+        if(strcmp(argv[i],"--late-input")==0){
+            useLateInput = 1;
+        }
+        if(strcmp(argv[i],"--load")==0){
+            game.loadSave = 1;
+        }
     }
 
-}
-
-int main(int argc, char *argv[])
-{
     initSDL("Isometric Game Tutorial - Part 2 - By Johan Forsblom");
+
+    //has to be up before init() so the textures get a copy in RAM
+    if(useSoftwareRenderer){
+        if(softRendererInit(getRenderer(),WINDOW_WIDTH,WINDOW_HEIGHT,SOFT_KERNEL_AUTO)){
+            fprintf(stdout,"software renderer: %s blend kernel\n",softRendererKernelName());
+        }
+        else{
+            fprintf(stderr,"Warning, falling back to the SDL renderer\n");
+        }
+    }
     init();
+    game.lateInput = useLateInput;
+
+    //installed before the first event is pumped so nothing arrives untraced
+    latencyInit(&game.latency);
 
     SDL_ShowCursor(0);
     SDL_SetWindowGrab(getWindow(),SDL_TRUE);
     SDL_WarpMouseInWindow(getWindow(),WINDOW_WIDTH/2,WINDOW_HEIGHT/2);
 
     while(!game.loopDone){
-        update();
-        updateInput();
-        draw();
+        memArenaReset(&game.frameArena);
+        if(game.lateInput){
+            //sleep first, then pump the events and sample the mouse right before the frame is built,
+            //the default order below draws with a mouse state pumped before the previous frame was drawn
+            SDL_Delay(10);
+            updateInput();
+            update();
+            draw();
+        }
+        else{
+            update();
+            updateInput();
+            draw();
+            //Don't be a CPU HOG!! :D
+            SDL_Delay(10);
+        }
     }
 
+    latencyPrintStats(&game.latency,game.lateInput ? "late input" : "default loop order");
+    latencyClose(&game.latency);
+
+    occlusionPrintStats(&game.occlusion);
+    occlusionClose(&game.occlusion);
+    memArenaPrintStats(&game.frameArena);
+    memArenaClose(&game.frameArena);
+    particleSystemClose(&game.particles);
+    mapLodClose(&game.mapLod);
+    worldClose(&game.world);
+    jobSystemClose();
+    textureFree(&tilesTex);
+    textureFree(&characterTex);
+    softRendererClose();
+    resourcePrintStats();
+    resourceClose();
     closeDownSDL();
     return 0;
 }
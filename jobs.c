@@ -0,0 +1,355 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jobs.h"
+
+#define JOB_QUEUE_MASK          (JOB_QUEUE_SIZE-1)
+#define JOB_IDLE_WAIT_MS        2
+
+/*
+ *  Chase-Lev work stealing deque. The owning thread pushes and pops at the bottom,
+ *  other threads steal from the top. Jobs are stored by value, a slot can only be
+ *  overwritten once bottom has moved a full queue ahead of top, which push refuses.
+ */
+typedef struct jobDequeT
+{
+    SDL_atomic_t top;
+    SDL_atomic_t bottom;
+    jobT jobs[JOB_QUEUE_SIZE];
+}jobDequeT;
+
+typedef struct jobWorkerT
+{
+    jobDequeT deque;
+    SDL_Thread *thread;
+    SDL_threadID threadID;
+    Uint32 randomState;
+}jobWorkerT;
+
+//worker 0 is the thread that called jobSystemInit(...)
+static jobWorkerT *workers = NULL;
+static int numThreads = 0;
+static SDL_atomic_t quit;
+static SDL_atomic_t numSleeping;
+static SDL_sem *wakeSignal = NULL;
+
+static jobWorkerT *getCurrentWorker()
+{
+    int i;
+    SDL_threadID threadID = SDL_ThreadID();
+    for(i=0;i<numThreads;++i){
+        if(workers[i].threadID == threadID){
+            return &workers[i];
+        }
+    }
+    return NULL;
+}
+
+static int pushJob(jobDequeT *deque,jobT *job)
+{
+    int bottom = SDL_AtomicGet(&deque->bottom);
+    int top = SDL_AtomicGet(&deque->top);
+
+    if(bottom-top >= JOB_QUEUE_SIZE){
+        return 0;
+    }
+    deque->jobs[bottom&JOB_QUEUE_MASK] = *job;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&deque->bottom,bottom+1);
+    return 1;
+}
+
+static int popJob(jobDequeT *deque,jobT *job)
+{
+    int bottom;
+    int top;
+
+    //the new bottom has to be visible to the thieves before top is read, or the owner and a thief can both
+    //take the last job. SDL_AtomicSet is only an acquire barrier on some targets, a read-modify-write is a full one
+    bottom = SDL_AtomicAdd(&deque->bottom,-1)-1;
+    top = SDL_AtomicGet(&deque->top);
+
+    if(top>bottom){
+        SDL_AtomicSet(&deque->bottom,top);
+        return 0;
+    }
+    *job = deque->jobs[bottom&JOB_QUEUE_MASK];
+    if(top<bottom){
+        return 1;
+    }
+
+    //last job in the queue, race the thieves for it
+    if(!SDL_AtomicCAS(&deque->top,top,top+1)){
+        SDL_AtomicSet(&deque->bottom,top+1);
+        return 0;
+    }
+    SDL_AtomicSet(&deque->bottom,top+1);
+    return 1;
+}
+
+static int stealJob(jobDequeT *deque,jobT *job)
+{
+    int top = SDL_AtomicGet(&deque->top);
+    int bottom = SDL_AtomicGet(&deque->bottom);
+
+    if(top>=bottom){
+        return 0;
+    }
+    SDL_MemoryBarrierAcquire();
+    *job = deque->jobs[top&JOB_QUEUE_MASK];
+    return SDL_AtomicCAS(&deque->top,top,top+1);
+}
+
+static int findJob(jobWorkerT *self,jobT *job)
+{
+    int i,victim;
+
+    if(popJob(&self->deque,job)){
+        return 1;
+    }
+
+    //start at a random worker so the thieves don't all pile onto the same queue
+    self->randomState = self->randomState*1664525u+1013904223u;
+    victim = (self->randomState>>16)%numThreads;
+    for(i=0;i<numThreads;++i){
+        if(&workers[victim] != self && stealJob(&workers[victim].deque,job)){
+            return 1;
+        }
+        victim = (victim+1)%numThreads;
+    }
+    return 0;
+}
+
+static void submitJob(jobT *job);
+
+static void finishJob(jobCounterT *counter)
+{
+    jobT dependents[JOB_MAX_DEPENDENTS];
+    int numDependents = 0;
+    int i;
+
+    //the lock keeps jobWait(...) from returning (and the counter going out of scope) until we are done with it
+    SDL_AtomicLock(&counter->lock);
+    if(SDL_AtomicAdd(&counter->count,-1)==1){
+        numDependents = counter->numDependents;
+        memcpy(dependents,counter->dependents,numDependents*sizeof(jobT));
+        counter->numDependents = 0;
+    }
+    SDL_AtomicUnlock(&counter->lock);
+
+    for(i=0;i<numDependents;++i){
+        submitJob(&dependents[i]);
+    }
+}
+
+static void executeJob(jobT *job)
+{
+    job->function(job->data,job->start,job->end);
+    if(job->counter != NULL){
+        finishJob(job->counter);
+    }
+}
+
+//the job's counter has already been incremented by the caller
+static void submitJob(jobT *job)
+{
+    jobWorkerT *self = getCurrentWorker();
+
+    //threads outside the job system and full queues simply run the job right away
+    if(self == NULL || !pushJob(&self->deque,job)){
+        executeJob(job);
+        return;
+    }
+    if(SDL_AtomicGet(&numSleeping)>0){
+        SDL_SemPost(wakeSignal);
+    }
+}
+
+static int workerThreadMain(void *data)
+{
+    jobWorkerT *self = (jobWorkerT*)data;
+    jobT job;
+
+    while(!SDL_AtomicGet(&quit))
+    {
+        if(findJob(self,&job)){
+            executeJob(&job);
+            continue;
+        }
+        SDL_AtomicAdd(&numSleeping,1);
+        SDL_SemWaitTimeout(wakeSignal,JOB_IDLE_WAIT_MS);
+        SDL_AtomicAdd(&numSleeping,-1);
+    }
+    return 0;
+}
+
+int jobSystemInit(int numWorkerThreads)
+{
+    int i;
+    char name[32];
+
+    if(numWorkerThreads<0){
+        numWorkerThreads = SDL_GetCPUCount()-1;
+    }
+    if(numWorkerThreads>JOB_MAX_THREADS-1){
+        numWorkerThreads = JOB_MAX_THREADS-1;
+    }
+    if(numWorkerThreads<0){
+        numWorkerThreads = 0;
+    }
+
+    workers = calloc(numWorkerThreads+1,sizeof(jobWorkerT));
+    wakeSignal = SDL_CreateSemaphore(0);
+    if(workers == NULL || wakeSignal == NULL){
+        fprintf(stderr,"Error in jobSystemInit(...): could not create the job system! SDL Error:%s\n",SDL_GetError());
+        jobSystemClose();
+        return 0;
+    }
+    SDL_AtomicSet(&quit,0);
+    SDL_AtomicSet(&numSleeping,0);
+
+    workers[0].threadID = SDL_ThreadID();
+    workers[0].randomState = 1;
+    numThreads = numWorkerThreads+1;
+
+    for(i=1;i<numThreads;++i){
+        workers[i].randomState = i*7919+1;
+        snprintf(name,sizeof(name),"jobWorker%d",i);
+        workers[i].thread = SDL_CreateThread(workerThreadMain,name,&workers[i]);
+        if(workers[i].thread == NULL){
+            fprintf(stderr,"Error in jobSystemInit(...): could not create worker thread! SDL Error:%s\n",SDL_GetError());
+            jobSystemClose();
+            return 0;
+        }
+        //set here rather than by the worker itself, no job can reach getCurrentWorker() before we return
+        workers[i].threadID = SDL_GetThreadID(workers[i].thread);
+    }
+    return 1;
+}
+
+int jobSystemNumThreads()
+{
+    return numThreads>0 ? numThreads : 1;
+}
+
+void jobCounterInit(jobCounterT *counter)
+{
+    SDL_AtomicSet(&counter->count,0);
+    counter->lock = 0;
+    counter->numDependents = 0;
+}
+
+void jobRun(jobFunctionT function,void *data,int start,int end,jobCounterT *counter)
+{
+    jobT job;
+
+    job.function = function;
+    job.data = data;
+    job.start = start;
+    job.end = end;
+    job.counter = counter;
+    if(counter != NULL){
+        SDL_AtomicAdd(&counter->count,1);
+    }
+    submitJob(&job);
+}
+
+void jobRunAfter(jobCounterT *dependency,jobFunctionT function,void *data,int start,int end,jobCounterT *counter)
+{
+    jobT job;
+
+    job.function = function;
+    job.data = data;
+    job.start = start;
+    job.end = end;
+    job.counter = counter;
+    if(counter != NULL){
+        SDL_AtomicAdd(&counter->count,1);
+    }
+
+    SDL_AtomicLock(&dependency->lock);
+    if(SDL_AtomicGet(&dependency->count)>0 && dependency->numDependents<JOB_MAX_DEPENDENTS){
+        dependency->dependents[dependency->numDependents++] = job;
+        SDL_AtomicUnlock(&dependency->lock);
+        return;
+    }
+    SDL_AtomicUnlock(&dependency->lock);
+
+    //either the dependency is already done or its list is full, in which case we wait for it here
+    jobWait(dependency);
+    submitJob(&job);
+}
+
+void jobParallelFor(jobFunctionT function,void *data,int count,int grainSize,jobCounterT *counter)
+{
+    jobT job;
+    int start,numJobs;
+
+    if(count<=0){
+        return;
+    }
+    if(grainSize<=0){
+        grainSize = count/(jobSystemNumThreads()*4);
+        if(grainSize<1){
+            grainSize = 1;
+        }
+    }
+    numJobs = (count+grainSize-1)/grainSize;
+
+    //count every slice up front so the counter can't reach zero half way through submitting
+    if(counter != NULL){
+        SDL_AtomicAdd(&counter->count,numJobs);
+    }
+    job.function = function;
+    job.data = data;
+    job.counter = counter;
+    for(start=0;start<count;start+=grainSize){
+        job.start = start;
+        job.end = start+grainSize<count ? start+grainSize : count;
+        submitJob(&job);
+    }
+}
+
+void jobWait(jobCounterT *counter)
+{
+    jobWorkerT *self = getCurrentWorker();
+    jobT job;
+
+    //help out with the queued work instead of sleeping
+    while(SDL_AtomicGet(&counter->count)>0)
+    {
+        if(self != NULL && findJob(self,&job)){
+            executeJob(&job);
+        }
+        else{
+            SDL_Delay(0);
+        }
+    }
+    SDL_AtomicLock(&counter->lock);
+    SDL_AtomicUnlock(&counter->lock);
+}
+
+void jobSystemClose()
+{
+    int i;
+
+    SDL_AtomicSet(&quit,1);
+    if(workers != NULL){
+        for(i=1;i<numThreads;++i){
+            SDL_SemPost(wakeSignal);
+        }
+        for(i=1;i<numThreads;++i){
+            if(workers[i].thread != NULL){
+                SDL_WaitThread(workers[i].thread,NULL);
+            }
+        }
+        free(workers);
+        workers = NULL;
+    }
+    if(wakeSignal != NULL){
+        SDL_DestroySemaphore(wakeSignal);
+        wakeSignal = NULL;
+    }
+    numThreads = 0;
+}
@@ -0,0 +1,44 @@
+#ifndef JOBS_H_
+#define JOBS_H_
+#include <SDL2/SDL.h>
+
+#define JOB_MAX_THREADS         16
+#define JOB_QUEUE_SIZE          4096
+#define JOB_MAX_DEPENDENTS      32
+
+//a job works on the index range [start,end) of whatever data it is given
+typedef void (*jobFunctionT)(void *data,int start,int end);
+
+typedef struct jobCounterT jobCounterT;
+
+typedef struct jobT
+{
+    jobFunctionT function;
+    void *data;
+    int start;
+    int end;
+    jobCounterT *counter;
+}jobT;
+
+/*
+ *  Counts the jobs that still have to finish. Jobs can be queued behind a counter
+ *  with jobRunAfter(...), they are submitted when the counter drops to zero.
+ */
+struct jobCounterT
+{
+    SDL_atomic_t count;
+    SDL_SpinLock lock;
+    int numDependents;
+    jobT dependents[JOB_MAX_DEPENDENTS];
+};
+
+int jobSystemInit(int numWorkerThreads);
+int jobSystemNumThreads();
+void jobCounterInit(jobCounterT *counter);
+void jobRun(jobFunctionT function,void *data,int start,int end,jobCounterT *counter);
+void jobRunAfter(jobCounterT *dependency,jobFunctionT function,void *data,int start,int end,jobCounterT *counter);
+void jobParallelFor(jobFunctionT function,void *data,int count,int grainSize,jobCounterT *counter);
+void jobWait(jobCounterT *counter);
+void jobSystemClose();
+
+#endif // JOBS_H_
@@ -0,0 +1,175 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <string.h>
+#include "latency.h"
+
+static const char *kindNames[LATENCY_NUM_KINDS] = {"mouse motion","keys/buttons/wheel"};
+
+//runs on whatever thread pushes the event, so only the pending list is touched and under the lock
+static int eventWatch(void *userdata,SDL_Event *event)
+{
+    latencyTraceT *trace = (latencyTraceT*)userdata;
+    int kind;
+
+    switch(event->type)
+    {
+        case SDL_MOUSEMOTION:
+            kind = LATENCY_MOUSE_MOTION;
+        break;
+
+        case SDL_KEYDOWN:
+        case SDL_KEYUP:
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP:
+        case SDL_MOUSEWHEEL:
+            kind = LATENCY_INPUT_EVENTS;
+        break;
+
+        default:
+            return 1;
+    }
+
+    SDL_AtomicLock(&trace->lock);
+    if(trace->numPending<LATENCY_MAX_EVENTS){
+        trace->pending[trace->numPending].arrival = SDL_GetPerformanceCounter();
+        trace->pending[trace->numPending].kind = kind;
+        trace->numPending++;
+    }
+    else{
+        trace->numDropped++;
+    }
+    SDL_AtomicUnlock(&trace->lock);
+    return 1;
+}
+
+int latencyInit(latencyTraceT *trace)
+{
+    if(trace == NULL)
+    {
+        fprintf(stderr,"Error in latencyInit(...): trace parameter is NULL!\n");
+        return 0;
+    }
+    memset(trace,0,sizeof(latencyTraceT));
+    SDL_AddEventWatch(eventWatch,trace);
+    trace->installed = 1;
+    return 1;
+}
+
+void latencyConsume(latencyTraceT *trace,int kind)
+{
+    int i;
+    int numLeft = 0;
+
+    SDL_AtomicLock(&trace->lock);
+    for(i=0;i<trace->numPending;++i){
+        if(trace->pending[i].kind != kind){
+            trace->pending[numLeft++] = trace->pending[i];
+        }
+        else if(trace->numFrame<LATENCY_MAX_EVENTS){
+            trace->frame[trace->numFrame++] = trace->pending[i];
+        }
+        else{
+            trace->numDropped++;
+        }
+    }
+    trace->numPending = numLeft;
+    SDL_AtomicUnlock(&trace->lock);
+}
+
+void latencyFramePresented(latencyTraceT *trace)
+{
+    Uint64 now = SDL_GetPerformanceCounter();
+    double frequency = (double)SDL_GetPerformanceFrequency();
+    latencyHistogramT *histogram;
+    double ms;
+    int bucket;
+    int i;
+
+    for(i=0;i<trace->numFrame;++i){
+        histogram = &trace->histograms[trace->frame[i].kind];
+        ms = (double)(now-trace->frame[i].arrival)*1000.0/frequency;
+        bucket = (int)(ms*1000.0/LATENCY_BUCKET_US);
+        if(bucket>=LATENCY_NUM_BUCKETS){
+            bucket = LATENCY_NUM_BUCKETS-1;
+        }
+        histogram->buckets[bucket]++;
+        histogram->count++;
+        histogram->totalMs += ms;
+        if(ms>histogram->maxMs){
+            histogram->maxMs = ms;
+        }
+    }
+    trace->numFrame = 0;
+    trace->numFrames++;
+}
+
+//upper edge of the bucket the percentile falls in
+static double getPercentile(latencyHistogramT *histogram,double percentile)
+{
+    Uint32 target = (Uint32)(percentile*histogram->count);
+    Uint32 sum = 0;
+    int i;
+
+    for(i=0;i<LATENCY_NUM_BUCKETS;++i){
+        sum += histogram->buckets[i];
+        if(sum>target){
+            break;
+        }
+    }
+    if(i>=LATENCY_NUM_BUCKETS-1){
+        return histogram->maxMs;
+    }
+    return SDL_min((i+1)*LATENCY_BUCKET_US/1000.0,histogram->maxMs);
+}
+
+static double getFractionBelow(latencyHistogramT *histogram,double ms)
+{
+    int lastBucket = (int)(ms*1000.0/LATENCY_BUCKET_US);
+    Uint32 sum = 0;
+    int i;
+
+    for(i=0;i<lastBucket && i<LATENCY_NUM_BUCKETS;++i){
+        sum += histogram->buckets[i];
+    }
+    return (double)sum/histogram->count;
+}
+
+void latencyPrintStats(latencyTraceT *trace,const char *label)
+{
+    latencyHistogramT *histogram;
+    int i;
+
+    fprintf(stdout,"\ninput to present latency, %s, %u frames:\n",label,trace->numFrames);
+    for(i=0;i<LATENCY_NUM_KINDS;++i){
+        histogram = &trace->histograms[i];
+        if(histogram->count==0){
+            fprintf(stdout,"  %-18s no events\n",kindNames[i]);
+            continue;
+        }
+        fprintf(stdout,"  %-18s %6u events, mean %6.2f ms, p50 %6.2f ms, p90 %6.2f ms, p99 %6.2f ms, max %6.2f ms\n",
+                kindNames[i],histogram->count,histogram->totalMs/histogram->count,getPercentile(histogram,0.5),
+                getPercentile(histogram,0.9),getPercentile(histogram,0.99),histogram->maxMs);
+        fprintf(stdout,"  %-18s <8ms %5.1f%%  <16ms %5.1f%%  <33ms %5.1f%%  <50ms %5.1f%%  <100ms %5.1f%%\n","",
+                getFractionBelow(histogram,8)*100.0,getFractionBelow(histogram,16)*100.0,getFractionBelow(histogram,33)*100.0,
+                getFractionBelow(histogram,50)*100.0,getFractionBelow(histogram,100)*100.0);
+    }
+    if(trace->numDropped){
+        fprintf(stdout,"  %u events were not traced, too many arrived within one frame\n",trace->numDropped);
+    }
+}
+
+void latencyReset(latencyTraceT *trace)
+{
+    memset(trace->histograms,0,sizeof(trace->histograms));
+    trace->numFrames = 0;
+    trace->numDropped = 0;
+}
+
+void latencyClose(latencyTraceT *trace)
+{
+    if(trace == NULL || !trace->installed){
+        return;
+    }
+    SDL_DelEventWatch(eventWatch,trace);
+    memset(trace,0,sizeof(latencyTraceT));
+}
@@ -0,0 +1,56 @@
+#ifndef LATENCY_H_
+#define LATENCY_H_
+#include <SDL2/SDL.h>
+
+#define LATENCY_BUCKET_US       100
+#define LATENCY_NUM_BUCKETS     2000
+#define LATENCY_MAX_EVENTS      512
+
+#define LATENCY_MOUSE_MOTION    0
+#define LATENCY_INPUT_EVENTS    1
+#define LATENCY_NUM_KINDS       2
+
+//time from an event arriving until the frame that used it was presented, in 0.1 ms buckets,
+//the last bucket also holds everything slower than that
+typedef struct latencyHistogramT
+{
+    Uint32 buckets[LATENCY_NUM_BUCKETS];
+    Uint32 count;
+    double totalMs;
+    double maxMs;
+}latencyHistogramT;
+
+typedef struct latencyEventT
+{
+    Uint64 arrival;
+    int kind;
+}latencyEventT;
+
+/*
+ *  An event watch stamps every input event when SDL pulls it off the OS queue (that is inside
+ *  SDL_PumpEvents/SDL_PollEvent, time before that is not seen). The loop calls latencyConsume(...)
+ *  where it actually reads the input, which hands the pending events to the frame being built,
+ *  and latencyFramePresented(...) once SDL_RenderPresent(...) has returned.
+ *  Mouse motion is consumed where the mouse state is sampled, everything else where it is polled.
+ */
+typedef struct latencyTraceT
+{
+    SDL_SpinLock lock;
+    latencyEventT pending[LATENCY_MAX_EVENTS];
+    int numPending;
+    latencyEventT frame[LATENCY_MAX_EVENTS];
+    int numFrame;
+    Uint32 numDropped;
+    Uint32 numFrames;
+    latencyHistogramT histograms[LATENCY_NUM_KINDS];
+    int installed;
+}latencyTraceT;
+
+int latencyInit(latencyTraceT *trace);
+void latencyConsume(latencyTraceT *trace,int kind);
+void latencyFramePresented(latencyTraceT *trace);
+void latencyPrintStats(latencyTraceT *trace,const char *label);
+void latencyReset(latencyTraceT *trace);
+void latencyClose(latencyTraceT *trace);
+
+#endif // LATENCY_H_
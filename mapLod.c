@@ -0,0 +1,264 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapLod.h"
+#include "jobs.h"
+#include "resources.h"
+
+static Uint8 mostCommon(Uint8 a,Uint8 b,Uint8 c,Uint8 d)
+{
+    Uint8 values[4] = {a,b,c,d};
+    Uint8 best = MAP_LOD_EMPTY;
+    int bestCount = 0;
+    int count,i,j;
+
+    for(i=0;i<4;++i){
+        if(values[i] == MAP_LOD_EMPTY){
+            continue;
+        }
+        count = 0;
+        for(j=0;j<4;++j){
+            count += values[j]==values[i];
+        }
+        //ties go to the higher tile, the rare tiles on top of the grass survive a bit longer that way
+        if(count>bestCount || (count==bestCount && values[i]>best)){
+            best = values[i];
+            bestCount = count;
+        }
+    }
+    return best;
+}
+
+int mapLodGetCell(mapLodT *lod,int level,int x,int y)
+{
+    if(level<0 || level>=lod->numLevels || x<0 || y<0 || x>=lod->width[level] || y>=lod->height[level]){
+        return MAP_LOD_EMPTY;
+    }
+    if(level == 0){
+        return (Uint8)mapStreamGetTile(lod->stream,x,y);
+    }
+    return lod->cells[level][y*lod->width[level]+x];
+}
+
+static Uint8 computeCell(mapLodT *lod,int level,int x,int y)
+{
+    return mostCommon(mapLodGetCell(lod,level-1,x*2,y*2),mapLodGetCell(lod,level-1,x*2+1,y*2),
+                      mapLodGetCell(lod,level-1,x*2,y*2+1),mapLodGetCell(lod,level-1,x*2+1,y*2+1));
+}
+
+static Uint8 getChunkTile(mapLodT *lod,Uint8 *tiles,int chunkX,int chunkY,int x,int y)
+{
+    if(chunkX*MAP_CHUNK_SIZE+x >= lod->width[0] || chunkY*MAP_CHUNK_SIZE+y >= lod->height[0]){
+        return MAP_LOD_EMPTY;
+    }
+    return tiles[MAP_CHUNK_TILE_INDEX(x,y)];
+}
+
+//every chunk fills in its own corner of the levels that are no bigger than a chunk, so the jobs never share a cell
+static void buildChunkLevels(void *data,int start,int end)
+{
+    mapLodT *lod = (mapLodT*)data;
+    Uint8 tiles[MAP_CHUNK_TILES];
+    int i,level,x,y;
+    int chunkX,chunkY,cellsPerChunk;
+    int minX,minY,maxX,maxY;
+
+    for(i=start;i<end;++i){
+        chunkX = i%lod->stream->chunksWide;
+        chunkY = i/lod->stream->chunksWide;
+        mapStreamReadChunk(lod->stream,chunkX,chunkY,tiles);
+
+        for(level=1;level<=MAP_CHUNK_SHIFT && level<lod->numLevels;++level){
+            cellsPerChunk = MAP_CHUNK_SIZE>>level;
+            minX = chunkX*cellsPerChunk;
+            minY = chunkY*cellsPerChunk;
+            maxX = SDL_min(minX+cellsPerChunk,lod->width[level]);
+            maxY = SDL_min(minY+cellsPerChunk,lod->height[level]);
+            for(y=minY;y<maxY;++y){
+                for(x=minX;x<maxX;++x){
+                    if(level == 1){
+                        lod->cells[1][y*lod->width[1]+x] = mostCommon(
+                            getChunkTile(lod,tiles,chunkX,chunkY,(x-minX)*2,(y-minY)*2),
+                            getChunkTile(lod,tiles,chunkX,chunkY,(x-minX)*2+1,(y-minY)*2),
+                            getChunkTile(lod,tiles,chunkX,chunkY,(x-minX)*2,(y-minY)*2+1),
+                            getChunkTile(lod,tiles,chunkX,chunkY,(x-minX)*2+1,(y-minY)*2+1));
+                    }
+                    else{
+                        lod->cells[level][y*lod->width[level]+x] = computeCell(lod,level,x,y);
+                    }
+                }
+            }
+        }
+    }
+}
+
+typedef struct mapLodCacheHeaderT
+{
+    Uint32 magic;
+    Sint32 mapWidth;
+    Sint32 mapHeight;
+    Sint32 numLevels;
+}mapLodCacheHeaderT;
+
+static int readCache(mapLodT *lod)
+{
+    mapLodCacheHeaderT header;
+    FILE *file;
+    int level;
+    int ok;
+
+    file = fopen(lod->cacheFilename,"rb");
+    if(file == NULL){
+        return 0;
+    }
+    ok = fread(&header,sizeof(header),1,file) == 1 && header.magic == MAP_LOD_CACHE_MAGIC &&
+         header.mapWidth == lod->width[0] && header.mapHeight == lod->height[0] && header.numLevels == lod->numLevels;
+    for(level=1;level<lod->numLevels && ok;++level){
+        ok = fread(lod->cells[level],1,(size_t)lod->width[level]*lod->height[level],file) ==
+             (size_t)lod->width[level]*lod->height[level];
+    }
+    fclose(file);
+
+    //the chunk files may change from here on, only a clean close writes a cache that matches them again
+    remove(lod->cacheFilename);
+    return ok;
+}
+
+static void writeCache(mapLodT *lod)
+{
+    char tmpFilename[310];
+    mapLodCacheHeaderT header;
+    FILE *file;
+    int level;
+    int ok;
+
+    snprintf(tmpFilename,sizeof(tmpFilename),"%s.tmp",lod->cacheFilename);
+    file = fopen(tmpFilename,"wb");
+    if(file == NULL){
+        fprintf(stderr,"Map LOD warning: could not write %s\n",tmpFilename);
+        return;
+    }
+    header.magic = MAP_LOD_CACHE_MAGIC;
+    header.mapWidth = lod->width[0];
+    header.mapHeight = lod->height[0];
+    header.numLevels = lod->numLevels;
+    ok = fwrite(&header,sizeof(header),1,file) == 1;
+    for(level=1;level<lod->numLevels && ok;++level){
+        ok = fwrite(lod->cells[level],1,(size_t)lod->width[level]*lod->height[level],file) ==
+             (size_t)lod->width[level]*lod->height[level];
+    }
+    ok &= fclose(file) == 0;
+    if(!ok || rename(tmpFilename,lod->cacheFilename) != 0){
+        fprintf(stderr,"Map LOD warning: could not write %s\n",lod->cacheFilename);
+        remove(tmpFilename);
+    }
+}
+
+int mapLodInit(mapLodT *lod,mapStreamT *stream,int useCache)
+{
+    jobCounterT counter;
+    int level,x,y;
+
+    if(lod == NULL || stream == NULL)
+    {
+        fprintf(stderr,"Error in mapLodInit(...): bad parameters!\n");
+        return 0;
+    }
+    memset(lod,0,sizeof(mapLodT));
+    lod->resource = -1;
+    lod->stream = stream;
+    lod->width[0] = stream->mapWidth;
+    lod->height[0] = stream->mapHeight;
+    lod->numLevels = 1;
+
+    //halve until the whole map is a single cell
+    while(lod->numLevels<MAP_LOD_MAX_LEVELS && (lod->width[lod->numLevels-1]>1 || lod->height[lod->numLevels-1]>1)){
+        level = lod->numLevels;
+        lod->width[level] = (lod->width[level-1]+1)/2;
+        lod->height[level] = (lod->height[level-1]+1)/2;
+        lod->cells[level] = malloc((size_t)lod->width[level]*lod->height[level]);
+        lod->numLevels++;
+        if(lod->cells[level] == NULL){
+            fprintf(stderr,"Error in mapLodInit(...): out of memory!\n");
+            mapLodClose(lod);
+            return 0;
+        }
+    }
+
+    if(stream->directory[0] != '\0'){
+        snprintf(lod->cacheFilename,sizeof(lod->cacheFilename),"%s/lod.cache",stream->directory);
+        if(!useCache){
+            remove(lod->cacheFilename);
+        }
+        else if(readCache(lod)){
+            lod->resource = resourceAdd(RESOURCE_MAP_LOD,mapLodSizeInBytes(lod),NULL,NULL,0);
+            return 1;
+        }
+    }
+
+    //the map is read chunk by chunk from disk or the generator, nothing has to be resident
+    jobCounterInit(&counter);
+    jobParallelFor(buildChunkLevels,lod,stream->chunksWide*stream->chunksHigh,0,&counter);
+    jobWait(&counter);
+
+    for(level=MAP_CHUNK_SHIFT+1;level<lod->numLevels;++level){
+        for(y=0;y<lod->height[level];++y){
+            for(x=0;x<lod->width[level];++x){
+                lod->cells[level][y*lod->width[level]+x] = computeCell(lod,level,x,y);
+            }
+        }
+    }
+    lod->resource = resourceAdd(RESOURCE_MAP_LOD,mapLodSizeInBytes(lod),NULL,NULL,0);
+    return 1;
+}
+
+//call after a tile has been changed in the stream, only one cell per level is recomputed
+void mapLodUpdateTile(mapLodT *lod,int x,int y)
+{
+    int level;
+    Uint8 cell;
+
+    for(level=1;level<lod->numLevels;++level){
+        x >>= 1;
+        y >>= 1;
+        if(x<0 || y<0 || x>=lod->width[level] || y>=lod->height[level]){
+            return;
+        }
+        cell = computeCell(lod,level,x,y);
+        //nothing above can change if this cell did not
+        if(lod->cells[level][y*lod->width[level]+x] == cell){
+            return;
+        }
+        lod->cells[level][y*lod->width[level]+x] = cell;
+    }
+}
+
+int mapLodSizeInBytes(mapLodT *lod)
+{
+    int level;
+    int size = 0;
+    for(level=1;level<lod->numLevels;++level){
+        size += lod->width[level]*lod->height[level];
+    }
+    return size;
+}
+
+void mapLodClose(mapLodT *lod)
+{
+    int level;
+
+    if(lod == NULL){
+        return;
+    }
+    //only a complete pyramid is worth keeping
+    if(lod->cacheFilename[0] != '\0' && lod->resource>=0){
+        writeCache(lod);
+    }
+    resourceRemove(lod->resource);
+    for(level=0;level<MAP_LOD_MAX_LEVELS;++level){
+        free(lod->cells[level]);
+    }
+    memset(lod,0,sizeof(mapLodT));
+    lod->resource = -1;
+}
@@ -0,0 +1,38 @@
+#ifndef MAPLOD_H_
+#define MAPLOD_H_
+#include <SDL2/SDL.h>
+#include "mapStream.h"
+
+#define MAP_LOD_MAX_LEVELS  16
+#define MAP_LOD_EMPTY       0xff
+#define MAP_LOD_CACHE_MAGIC 0x43444f4c
+
+/*
+ *  Multi-resolution copy of the map for drawing it zoomed far out. A cell on level n
+ *  covers 2^n x 2^n tiles and holds the most common tile of the four cells below it,
+ *  level 0 is the map itself and is not stored. The whole pyramid stays in memory, so
+ *  it is about a third of the size of the full map at one byte per tile.
+ *  Building it reads every chunk of the map, so a map with a directory keeps the pyramid
+ *  in lod.cache between runs. The file is written by mapLodClose(...) and taken away when
+ *  it is read, so a run that never got to close always builds the pyramid again.
+ */
+typedef struct mapLodT
+{
+    int numLevels;
+    int width[MAP_LOD_MAX_LEVELS];
+    int height[MAP_LOD_MAX_LEVELS];
+    Uint8 *cells[MAP_LOD_MAX_LEVELS];
+    mapStreamT *stream;
+    int resource;
+    //empty for a map that only lives in memory
+    char cacheFilename[300];
+}mapLodT;
+
+//useCache 0 builds from the chunk files, for when they were changed behind the pyramid (a loaded save)
+int mapLodInit(mapLodT *lod,mapStreamT *stream,int useCache);
+int mapLodGetCell(mapLodT *lod,int level,int x,int y);
+void mapLodUpdateTile(mapLodT *lod,int x,int y);
+int mapLodSizeInBytes(mapLodT *lod);
+void mapLodClose(mapLodT *lod);
+
+#endif // MAPLOD_H_
@@ -0,0 +1,268 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapSave.h"
+
+//tiles that did not change between two runs are still stored when the gap is shorter than this,
+//a new run costs four bytes
+#define MAP_SAVE_MIN_GAP    4
+
+typedef struct mapSaveHeaderT
+{
+    Uint32 magic;
+    Uint32 version;
+    Uint32 saveNumber;
+    Uint32 extraSize;
+    Uint32 numChunks;
+}mapSaveHeaderT;
+
+static void getSaveFilename(mapStreamT *stream,int saveNumber,const char *extension,char *filename,int size)
+{
+    snprintf(filename,size,"%s/save_%04d.%s",stream->directory,saveNumber,extension);
+}
+
+static void getPristineChunk(mapStreamT *stream,int chunkX,int chunkY,Uint8 *tiles)
+{
+    if(stream->generator != NULL){
+        stream->generator(chunkX,chunkY,tiles);
+    }
+    else{
+        memset(tiles,0,MAP_CHUNK_TILES);
+    }
+}
+
+int mapSaveFindLatest(mapStreamT *stream)
+{
+    char filename[300];
+    FILE *file;
+    int saveNumber = 0;
+
+    if(stream->directory[0] == '\0'){
+        return 0;
+    }
+    for(;;){
+        getSaveFilename(stream,saveNumber+1,"sav",filename,sizeof(filename));
+        file = fopen(filename,"rb");
+        if(file == NULL){
+            return saveNumber;
+        }
+        fclose(file);
+        saveNumber++;
+    }
+}
+
+//a chunk record is the number of runs followed by start, length and the tiles of every run
+static int encodeDelta(const Uint8 *tiles,const Uint8 *pristine,Uint8 *buffer)
+{
+    Uint16 numRuns = 0;
+    Uint16 start,length;
+    int size = sizeof(Uint16);
+    int i = 0;
+    int gap;
+
+    while(i<MAP_CHUNK_TILES){
+        if(tiles[i] == pristine[i]){
+            ++i;
+            continue;
+        }
+        start = (Uint16)i;
+        gap = 0;
+        while(i<MAP_CHUNK_TILES && gap<MAP_SAVE_MIN_GAP){
+            gap = tiles[i]==pristine[i] ? gap+1 : 0;
+            ++i;
+        }
+        length = (Uint16)(i-gap-start);
+        memcpy(&buffer[size],&start,sizeof(Uint16));
+        memcpy(&buffer[size+2],&length,sizeof(Uint16));
+        memcpy(&buffer[size+4],&tiles[start],length);
+        size += 4+length;
+        numRuns++;
+    }
+    memcpy(buffer,&numRuns,sizeof(Uint16));
+    return size;
+}
+
+static int decodeDelta(FILE *file,Uint8 *tiles)
+{
+    Uint16 numRuns,start,length;
+    int i;
+
+    if(fread(&numRuns,sizeof(Uint16),1,file) != 1){
+        return 0;
+    }
+    for(i=0;i<numRuns;++i){
+        if(fread(&start,sizeof(Uint16),1,file) != 1 || fread(&length,sizeof(Uint16),1,file) != 1 ||
+           start+length>MAP_CHUNK_TILES || fread(&tiles[start],1,length,file) != length){
+            return 0;
+        }
+    }
+    return 1;
+}
+
+//called on the I/O thread, chunks that are not in the snapshot are read back from their files,
+//which are in the state they had when the snapshot was taken because the I/O thread works in order
+int mapSaveWrite(mapStreamT *stream,mapSnapshotT *snapshot)
+{
+    char filename[300];
+    char tmpFilename[300];
+    Uint8 tiles[MAP_CHUNK_TILES];
+    Uint8 pristine[MAP_CHUNK_TILES];
+    Uint8 buffer[MAP_CHUNK_TILES*2];
+    mapSaveHeaderT header;
+    mapSnapshotChunkT *chunk;
+    FILE *file;
+    Sint32 position[2];
+    int size,i;
+    int ok = 1;
+
+    getSaveFilename(stream,snapshot->saveNumber,"sav",filename,sizeof(filename));
+    getSaveFilename(stream,snapshot->saveNumber,"tmp",tmpFilename,sizeof(tmpFilename));
+    file = fopen(tmpFilename,"wb");
+    if(file == NULL){
+        fprintf(stderr,"Map save error: could not write %s\n",tmpFilename);
+        return 0;
+    }
+
+    header.magic = MAP_SAVE_MAGIC;
+    header.version = MAP_SAVE_VERSION;
+    header.saveNumber = snapshot->saveNumber;
+    header.extraSize = snapshot->extraSize;
+    header.numChunks = snapshot->numChunks;
+    ok &= fwrite(&header,sizeof(header),1,file) == 1;
+    ok &= fwrite(snapshot->extra,1,snapshot->extraSize,file) == (size_t)snapshot->extraSize;
+    snapshot->bytesWritten = sizeof(header)+snapshot->extraSize;
+
+    for(i=0;i<snapshot->numChunks && ok;++i){
+        chunk = &snapshot->chunks[i];
+        if(chunk->data == NULL){
+            mapStreamReadChunk(stream,chunk->chunkX,chunk->chunkY,tiles);
+        }
+        else{
+            memcpy(tiles,chunk->data->tiles,MAP_CHUNK_TILES);
+        }
+        getPristineChunk(stream,chunk->chunkX,chunk->chunkY,pristine);
+        size = encodeDelta(tiles,pristine,buffer);
+
+        position[0] = chunk->chunkX;
+        position[1] = chunk->chunkY;
+        ok &= fwrite(position,sizeof(position),1,file) == 1;
+        ok &= fwrite(buffer,1,size,file) == (size_t)size;
+        snapshot->bytesWritten += sizeof(position)+size;
+    }
+    ok &= fclose(file) == 0;
+
+    //only a complete file gets the real name, a save that died halfway never breaks the chain
+    if(!ok || rename(tmpFilename,filename) != 0){
+        fprintf(stderr,"Map save error: could not write %s\n",filename);
+        remove(tmpFilename);
+        return 0;
+    }
+    return 1;
+}
+
+static int readHeader(FILE *file,mapSaveHeaderT *header,int saveNumber)
+{
+    return fread(header,sizeof(mapSaveHeaderT),1,file) == 1 && header->magic == MAP_SAVE_MAGIC &&
+           header->version == MAP_SAVE_VERSION && header->saveNumber == (Uint32)saveNumber &&
+           header->extraSize <= MAP_SAVE_MAX_EXTRA;
+}
+
+static void freeRestored(Uint8 **restored,int *restoredList,int numRestored)
+{
+    int i;
+    for(i=0;i<numRestored;++i){
+        free(restored[restoredList[i]]);
+    }
+    free(restored);
+    free(restoredList);
+}
+
+//rewrites the chunk files to what they were at the latest save, nothing may be resident.
+//Every save in the chain is read and checked before the first chunk file is touched,
+//so a missing or damaged save leaves the map as it was
+int mapSaveRestore(mapStreamT *stream,void *extra,int extraSize)
+{
+    char filename[300];
+    Uint8 tiles[MAP_CHUNK_TILES];
+    Uint8 saveExtra[MAP_SAVE_MAX_EXTRA];
+    Uint8 **restored;
+    int *restoredList;
+    int numRestored = 0;
+    mapSaveHeaderT header;
+    Sint32 position[2];
+    FILE *file;
+    int saveNumber;
+    int numChunks = stream->chunksWide*stream->chunksHigh;
+    int i,index;
+    int ok = 1;
+
+    restored = calloc(numChunks,sizeof(Uint8*));
+    restoredList = malloc(numChunks*sizeof(int));
+    if(restored == NULL || restoredList == NULL){
+        fprintf(stderr,"Error in mapSaveRestore(...): out of memory!\n");
+        free(restored);
+        free(restoredList);
+        return 0;
+    }
+
+    for(saveNumber=stream->saveNumber;saveNumber>=1 && ok;--saveNumber){
+        getSaveFilename(stream,saveNumber,"sav",filename,sizeof(filename));
+        file = fopen(filename,"rb");
+        if(file == NULL || !readHeader(file,&header,saveNumber) ||
+           fread(saveExtra,1,header.extraSize,file) != header.extraSize){
+            fprintf(stderr,"Map save error: %s is missing or damaged\n",filename);
+            if(file != NULL){
+                fclose(file);
+            }
+            ok = 0;
+            break;
+        }
+        if(saveNumber == stream->saveNumber && extra != NULL){
+            memset(extra,0,extraSize);
+            memcpy(extra,saveExtra,SDL_min((int)header.extraSize,extraSize));
+        }
+
+        for(i=0;i<(int)header.numChunks;++i){
+            if(fread(position,sizeof(position),1,file) != 1 || position[0]<0 || position[1]<0 ||
+               position[0]>=stream->chunksWide || position[1]>=stream->chunksHigh){
+                ok = 0;
+                break;
+            }
+            getPristineChunk(stream,position[0],position[1],tiles);
+            if(!decodeDelta(file,tiles)){
+                ok = 0;
+                break;
+            }
+            //a newer save already had this chunk
+            index = position[1]*stream->chunksWide+position[0];
+            if(restored[index] != NULL){
+                continue;
+            }
+            restored[index] = malloc(MAP_CHUNK_TILES);
+            if(restored[index] == NULL){
+                fprintf(stderr,"Error in mapSaveRestore(...): out of memory!\n");
+                ok = 0;
+                break;
+            }
+            memcpy(restored[index],tiles,MAP_CHUNK_TILES);
+            restoredList[numRestored++] = index;
+        }
+        if(!ok){
+            fprintf(stderr,"Map save error: %s is damaged\n",filename);
+        }
+        fclose(file);
+    }
+    if(!ok){
+        freeRestored(restored,restoredList,numRestored);
+        return 0;
+    }
+
+    //the whole chain checked out, only now the chunk files are rewritten.
+    //Chunks no save knows about were never changed, whatever their files say now
+    for(index=0;index<numChunks;++index){
+        ok &= mapStreamWriteChunk(stream,index%stream->chunksWide,index/stream->chunksWide,restored[index]);
+    }
+    freeRestored(restored,restoredList,numRestored);
+    return ok;
+}
@@ -0,0 +1,19 @@
+#ifndef MAPSAVE_H_
+#define MAPSAVE_H_
+#include <SDL2/SDL.h>
+#include "mapStream.h"
+
+#define MAP_SAVE_MAGIC      0x56415349
+#define MAP_SAVE_VERSION    1
+
+/*
+ *  Save files are numbered save_0001.sav, save_0002.sav, ... in the map directory. Every save
+ *  only holds the chunks changed since the one before, and every chunk is stored as the runs of
+ *  tiles that differ from what the generator makes. Loading walks the saves from the newest to
+ *  the oldest and the first record of a chunk wins.
+ */
+int mapSaveFindLatest(mapStreamT *stream);
+int mapSaveWrite(mapStreamT *stream,mapSnapshotT *snapshot);
+int mapSaveRestore(mapStreamT *stream,void *extra,int extraSize);
+
+#endif // MAPSAVE_H_
@@ -0,0 +1,802 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mapStream.h"
+#include "resources.h"
+#include "mapSave.h"
+
+#define MAP_STREAM_REQUEST_LOAD     0
+#define MAP_STREAM_REQUEST_SAVE     1
+#define MAP_STREAM_REQUEST_SNAPSHOT 2
+
+typedef struct mapChunkFileHeaderT
+{
+    Uint32 magic;
+    Uint32 version;
+}mapChunkFileHeaderT;
+
+static int queuePush(mapStreamQueueT *queue,int type,mapChunkT *chunk,mapSnapshotT *snapshot)
+{
+    mapStreamRequestT *request;
+
+    if(queue->count>=queue->capacity){
+        return 0;
+    }
+    request = &queue->requests[(queue->head+queue->count)%queue->capacity];
+    request->type = type;
+    request->chunk = chunk;
+    request->snapshot = snapshot;
+    queue->count++;
+    return 1;
+}
+
+static int queuePop(mapStreamQueueT *queue,mapStreamRequestT *request)
+{
+    if(queue->count==0){
+        return 0;
+    }
+    *request = queue->requests[queue->head];
+    queue->head = (queue->head+1)%queue->capacity;
+    queue->count--;
+    return 1;
+}
+
+static void getChunkFilename(mapStreamT *stream,int chunkX,int chunkY,char *filename,int size)
+{
+    snprintf(filename,size,"%s/chunk_%d_%d.map",stream->directory,chunkX,chunkY);
+}
+
+//a chunk file without a header holds exactly one chunk of tiles row by row, nothing more
+static int readOldChunkFile(FILE *file,Uint8 *tiles)
+{
+    Uint8 rowMajor[MAP_CHUNK_TILES];
+    int x,y;
+
+    rewind(file);
+    if(fread(rowMajor,1,MAP_CHUNK_TILES,file) != MAP_CHUNK_TILES || fgetc(file) != EOF){
+        return 0;
+    }
+    for(y=0;y<MAP_CHUNK_SIZE;++y){
+        for(x=0;x<MAP_CHUNK_SIZE;++x){
+            tiles[MAP_CHUNK_TILE_INDEX(x,y)] = rowMajor[y*MAP_CHUNK_SIZE+x];
+        }
+    }
+    return 1;
+}
+
+static int readChunkFile(FILE *file,const char *filename,Uint8 *tiles)
+{
+    mapChunkFileHeaderT header;
+
+    if(fread(&header,sizeof(header),1,file) == 1 && header.magic == MAP_CHUNK_FILE_MAGIC){
+        if(header.version != MAP_CHUNK_FILE_VERSION){
+            fprintf(stderr,"Map stream warning: chunk file %s has version %u, this build reads %d, regenerating it\n",
+                    filename,header.version,MAP_CHUNK_FILE_VERSION);
+            return 0;
+        }
+        if(fread(tiles,1,MAP_CHUNK_TILES,file) != MAP_CHUNK_TILES){
+            fprintf(stderr,"Map stream warning: chunk file %s is truncated, regenerating it\n",filename);
+            return 0;
+        }
+        return 1;
+    }
+    if(readOldChunkFile(file,tiles)){
+        return 1;
+    }
+    fprintf(stderr,"Map stream warning: chunk file %s is not a chunk file, regenerating it\n",filename);
+    return 0;
+}
+
+void mapStreamReadChunk(mapStreamT *stream,int chunkX,int chunkY,Uint8 *tiles)
+{
+    char filename[300];
+    FILE *file = NULL;
+    int ok;
+
+    if(stream->directory[0] != '\0'){
+        getChunkFilename(stream,chunkX,chunkY,filename,sizeof(filename));
+        file = fopen(filename,"rb");
+    }
+    if(file != NULL){
+        ok = readChunkFile(file,filename,tiles);
+        fclose(file);
+        if(ok){
+            return;
+        }
+    }
+
+    //no file on disk yet, build the chunk from scratch
+    if(stream->generator != NULL){
+        stream->generator(chunkX,chunkY,tiles);
+    }
+    else{
+        memset(tiles,0,MAP_CHUNK_TILES);
+    }
+}
+
+int mapStreamWriteChunk(mapStreamT *stream,int chunkX,int chunkY,const Uint8 *tiles)
+{
+    char filename[300];
+    FILE *file;
+    mapChunkFileHeaderT header;
+
+    getChunkFilename(stream,chunkX,chunkY,filename,sizeof(filename));
+    if(tiles == NULL){
+        remove(filename);
+        return 1;
+    }
+    file = fopen(filename,"wb");
+    if(file == NULL){
+        fprintf(stderr,"Map stream error: could not write chunk file %s\n",filename);
+        return 0;
+    }
+    header.magic = MAP_CHUNK_FILE_MAGIC;
+    header.version = MAP_CHUNK_FILE_VERSION;
+    if(fwrite(&header,sizeof(header),1,file) != 1 || fwrite(tiles,1,MAP_CHUNK_TILES,file) != MAP_CHUNK_TILES){
+        fprintf(stderr,"Map stream error: could not write chunk file %s\n",filename);
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    return 1;
+}
+
+static void loadChunk(mapStreamT *stream,mapChunkT *chunk)
+{
+    mapStreamReadChunk(stream,chunk->chunkX,chunk->chunkY,chunk->data->tiles);
+}
+
+static void saveChunk(mapStreamT *stream,mapChunkT *chunk)
+{
+    mapStreamWriteChunk(stream,chunk->chunkX,chunk->chunkY,chunk->data->tiles);
+}
+
+//the last one to let go gives the tiles back to the pool, only the main thread lets go
+static void releaseChunkData(mapStreamT *stream,mapChunkDataT *data)
+{
+    if(data != NULL && SDL_AtomicDecRef(&data->refCount)){
+        memPoolFree(&stream->dataPool,data);
+    }
+}
+
+//a chunk about to be loaded needs tiles nobody else is looking at
+static int prepareChunkData(mapStreamT *stream,mapChunkT *chunk)
+{
+    if(chunk->data != NULL && SDL_AtomicGet(&chunk->data->refCount) == 1){
+        return 1;
+    }
+    releaseChunkData(stream,chunk->data);
+    chunk->data = memPoolAlloc(&stream->dataPool);
+    if(chunk->data == NULL){
+        return 0;
+    }
+    SDL_AtomicSet(&chunk->data->refCount,1);
+    return 1;
+}
+
+static int isChunkInUse(mapChunkT *chunk)
+{
+    return chunk->state == MAP_CHUNK_LOADING || chunk->state == MAP_CHUNK_RESIDENT || chunk->state == MAP_CHUNK_SAVING;
+}
+
+static void markModified(mapStreamT *stream,int index)
+{
+    int *modifiedChunks;
+    int capacity;
+
+    if(stream->modifiedBits[index>>3] & (1<<(index&7))){
+        return;
+    }
+    if(stream->numModified>=stream->modifiedCapacity){
+        capacity = stream->modifiedCapacity ? stream->modifiedCapacity*2 : 256;
+        modifiedChunks = realloc(stream->modifiedChunks,capacity*sizeof(int));
+        if(modifiedChunks == NULL){
+            fprintf(stderr,"Map stream error: out of memory, a changed chunk will be missing from the next save\n");
+            return;
+        }
+        stream->modifiedChunks = modifiedChunks;
+        stream->modifiedCapacity = capacity;
+    }
+    stream->modifiedBits[index>>3] |= 1<<(index&7);
+    stream->modifiedChunks[stream->numModified++] = index;
+}
+
+static void clearModified(mapStreamT *stream)
+{
+    int i;
+    for(i=0;i<stream->numModified;++i){
+        stream->modifiedBits[stream->modifiedChunks[i]>>3] = 0;
+    }
+    stream->numModified = 0;
+}
+
+//the chunks changed since the last save survive a restart, otherwise the next save would miss them
+static void readUnsavedList(mapStreamT *stream)
+{
+    char filename[300];
+    FILE *file;
+    int index;
+
+    snprintf(filename,sizeof(filename),"%s/unsaved.lst",stream->directory);
+    file = fopen(filename,"rb");
+    if(file == NULL){
+        return;
+    }
+    while(fread(&index,sizeof(int),1,file) == 1){
+        if(index>=0 && index<stream->chunksWide*stream->chunksHigh){
+            markModified(stream,index);
+        }
+    }
+    fclose(file);
+}
+
+static void writeUnsavedList(mapStreamT *stream)
+{
+    char filename[300];
+    FILE *file;
+
+    snprintf(filename,sizeof(filename),"%s/unsaved.lst",stream->directory);
+    if(stream->numModified == 0){
+        remove(filename);
+        return;
+    }
+    file = fopen(filename,"wb");
+    if(file == NULL || fwrite(stream->modifiedChunks,sizeof(int),stream->numModified,file) != (size_t)stream->numModified){
+        fprintf(stderr,"Map stream error: could not write %s\n",filename);
+    }
+    if(file != NULL){
+        fclose(file);
+    }
+}
+
+static int ioThreadMain(void *data)
+{
+    mapStreamT *stream = (mapStreamT*)data;
+    mapStreamRequestT request;
+
+    SDL_LockMutex(stream->ioLock);
+    for(;;)
+    {
+        if(!queuePop(&stream->pending,&request)){
+            //drain the queue before quitting so that dirty chunks always reach the disk
+            if(stream->ioQuit){
+                break;
+            }
+            SDL_CondWait(stream->ioCond,stream->ioLock);
+            continue;
+        }
+
+        //do the file I/O without holding the lock so the main thread never waits on the disk
+        SDL_UnlockMutex(stream->ioLock);
+        if(request.type == MAP_STREAM_REQUEST_LOAD){
+            loadChunk(stream,request.chunk);
+        }
+        else if(request.type == MAP_STREAM_REQUEST_SAVE){
+            saveChunk(stream,request.chunk);
+        }
+        else{
+            request.snapshot->failed = !mapSaveWrite(stream,request.snapshot);
+        }
+        SDL_LockMutex(stream->ioLock);
+
+        queuePush(&stream->completed,request.type,request.chunk,request.snapshot);
+    }
+    SDL_UnlockMutex(stream->ioLock);
+    return 0;
+}
+
+int mapStreamInit(mapStreamT *stream,int mapWidth,int mapHeight,int memoryBudgetInBytes,
+                  const char *directory,mapChunkGeneratorT generator)
+{
+    if(stream == NULL)
+    {
+        fprintf(stderr,"Error in mapStreamInit(...): stream parameter is NULL!\n");
+        return 0;
+    }
+    memset(stream,0,sizeof(mapStreamT));
+
+    stream->mapWidth = mapWidth;
+    stream->mapHeight = mapHeight;
+    stream->chunksWide = (mapWidth+MAP_CHUNK_SIZE-1)/MAP_CHUNK_SIZE;
+    stream->chunksHigh = (mapHeight+MAP_CHUNK_SIZE-1)/MAP_CHUNK_SIZE;
+    stream->generator = generator;
+    if(directory != NULL){
+        snprintf(stream->directory,sizeof(stream->directory),"%s",directory);
+    }
+
+    //every chunk that is resident, loading or waiting to be saved counts against the budget
+    stream->maxResidentChunks = memoryBudgetInBytes/(int)(sizeof(mapChunkT)+sizeof(mapChunkDataT));
+    if(stream->maxResidentChunks<1){
+        stream->maxResidentChunks = 1;
+    }
+
+    if(memPoolInit(&stream->chunkPool,sizeof(mapChunkT),stream->maxResidentChunks,"map chunks")==0){
+        mapStreamClose(stream);
+        return 0;
+    }
+    //the tiles of every resident chunk, plus the ones a snapshot in flight still holds after they were copied
+    if(memPoolInit(&stream->dataPool,sizeof(mapChunkDataT),2*stream->maxResidentChunks,"map chunk tiles")==0){
+        mapStreamClose(stream);
+        return 0;
+    }
+    stream->chunkTable = calloc(stream->chunksWide*stream->chunksHigh,sizeof(mapChunkT*));
+    stream->modifiedBits = calloc((stream->chunksWide*stream->chunksHigh+7)/8,1);
+
+    //a chunk is in at most one queue at a time, so the queues never need to hold more than the pool
+    //and the one snapshot that may be in flight
+    stream->pending.capacity = stream->maxResidentChunks+1;
+    stream->pending.requests = calloc(stream->pending.capacity,sizeof(mapStreamRequestT));
+    stream->completed.capacity = stream->maxResidentChunks+1;
+    stream->completed.requests = calloc(stream->completed.capacity,sizeof(mapStreamRequestT));
+
+    if(stream->chunkTable == NULL || stream->modifiedBits == NULL ||
+       stream->pending.requests == NULL || stream->completed.requests == NULL){
+        fprintf(stderr,"Error in mapStreamInit(...): out of memory!\n");
+        mapStreamClose(stream);
+        return 0;
+    }
+
+    //without a directory the map only lives in memory and chunks are generated on the spot
+    if(stream->directory[0] == '\0'){
+        return 1;
+    }
+    stream->saveNumber = mapSaveFindLatest(stream);
+    readUnsavedList(stream);
+
+    stream->ioLock = SDL_CreateMutex();
+    stream->ioCond = SDL_CreateCond();
+    if(stream->ioLock == NULL || stream->ioCond == NULL){
+        fprintf(stderr,"Error in mapStreamInit(...): could not create I/O lock! SDL Error:%s\n",SDL_GetError());
+        mapStreamClose(stream);
+        return 0;
+    }
+
+    stream->ioThread = SDL_CreateThread(ioThreadMain,"mapStreamIO",stream);
+    if(stream->ioThread == NULL){
+        fprintf(stderr,"Error in mapStreamInit(...): could not create I/O thread! SDL Error:%s\n",SDL_GetError());
+        mapStreamClose(stream);
+        return 0;
+    }
+    return 1;
+}
+
+static void finishSnapshot(mapStreamT *stream,mapSnapshotT *snapshot)
+{
+    int i;
+
+    if(snapshot->failed){
+        //try again with the next save
+        for(i=0;i<snapshot->numChunks;++i){
+            markModified(stream,snapshot->chunks[i].chunkY*stream->chunksWide+snapshot->chunks[i].chunkX);
+        }
+        stream->saveNumber--;
+    }
+    else{
+        fprintf(stdout,"\nsave %d: %d changed chunks, %d bytes, snapshot %.3f ms on the main thread, written in %.1f ms\n",
+                snapshot->saveNumber,snapshot->numChunks,snapshot->bytesWritten,snapshot->snapshotSeconds*1000.0,
+                (double)(SDL_GetPerformanceCounter()-snapshot->takenAt)*1000.0/SDL_GetPerformanceFrequency());
+    }
+    //the tiles are let go here rather than on the I/O thread because the pool belongs to the main thread
+    for(i=0;i<snapshot->numChunks;++i){
+        releaseChunkData(stream,snapshot->chunks[i].data);
+    }
+    resourceRemove(snapshot->resource);
+    free(snapshot->chunks);
+    free(snapshot);
+    stream->snapshotInFlight = NULL;
+}
+
+static void processCompletedRequests(mapStreamT *stream)
+{
+    mapStreamRequestT request;
+    mapChunkT *chunk;
+
+    if(stream->ioThread == NULL){
+        return;
+    }
+    SDL_LockMutex(stream->ioLock);
+    while(queuePop(&stream->completed,&request))
+    {
+        chunk = request.chunk;
+        if(request.type == MAP_STREAM_REQUEST_SNAPSHOT){
+            finishSnapshot(stream,request.snapshot);
+        }
+        else if(request.type == MAP_STREAM_REQUEST_LOAD){
+            chunk->state = MAP_CHUNK_RESIDENT;
+            chunk->dirty = 0;
+            chunk->lastUsedFrame = stream->frame;
+        }
+        else{
+            chunk->state = MAP_CHUNK_FREE;
+            resourceRemove(chunk->resource);
+            chunk->resource = -1;
+            releaseChunkData(stream,chunk->data);
+            chunk->data = NULL;
+            memPoolFree(&stream->chunkPool,chunk);
+        }
+    }
+    SDL_UnlockMutex(stream->ioLock);
+}
+
+//returns NULL both when nothing can go and when the oldest chunk has to be written first,
+//*savingQueued tells the two apart
+static mapChunkT *evictLeastRecentlyUsed(mapStreamT *stream,int *savingQueued)
+{
+    int i;
+    mapChunkT *chunk;
+    mapChunkT *oldest = NULL;
+
+    *savingQueued = 0;
+    //chunks touched this frame are in view or prefetched and may not be evicted,
+    //edited chunks of a memory only map have nowhere to go so they stay as well
+    for(i=0;i<stream->chunkPool.numUsed;++i){
+        chunk = memPoolBlock(&stream->chunkPool,i);
+        if(chunk->state == MAP_CHUNK_RESIDENT && chunk->lastUsedFrame != stream->frame &&
+           (stream->ioThread != NULL || !chunk->dirty)){
+            if(oldest == NULL || chunk->lastUsedFrame < oldest->lastUsedFrame){
+                oldest = chunk;
+            }
+        }
+    }
+    if(oldest == NULL){
+        return NULL;
+    }
+
+    stream->chunkTable[oldest->chunkY*stream->chunksWide+oldest->chunkX] = NULL;
+
+    if(oldest->dirty){
+        //the slot comes back to the free list once the I/O thread has written it
+        oldest->state = MAP_CHUNK_SAVING;
+        queuePush(&stream->pending,MAP_STREAM_REQUEST_SAVE,oldest,NULL);
+        *savingQueued = 1;
+        return NULL;
+    }
+    oldest->state = MAP_CHUNK_FREE;
+    return oldest;
+}
+
+static void requestChunkRange(mapStreamT *stream,int minChunkX,int minChunkY,int maxChunkX,int maxChunkY)
+{
+    int x,y;
+    int resource;
+    int savingQueued;
+    mapChunkT *chunk;
+
+    if(minChunkX<0) minChunkX = 0;
+    if(minChunkY<0) minChunkY = 0;
+    if(maxChunkX>=stream->chunksWide) maxChunkX = stream->chunksWide-1;
+    if(maxChunkY>=stream->chunksHigh) maxChunkY = stream->chunksHigh-1;
+
+    for(y=minChunkY;y<=maxChunkY;++y){
+        for(x=minChunkX;x<=maxChunkX;++x){
+            chunk = stream->chunkTable[y*stream->chunksWide+x];
+            if(chunk != NULL){
+                chunk->lastUsedFrame = stream->frame;
+                continue;
+            }
+
+            //a chunk budget set in the resource registry can be tighter than the pool
+            chunk = NULL;
+            resource = resourceTryAdd(RESOURCE_MAP_CHUNKS,sizeof(mapChunkT)+sizeof(mapChunkDataT),NULL,NULL,0);
+            if(resource>=0){
+                chunk = memPoolAlloc(&stream->chunkPool);
+                if(chunk == NULL){
+                    resourceRemove(resource);
+                }
+                else{
+                    chunk->data = NULL;
+                    chunk->resource = resource;
+                }
+            }
+            //a reused chunk keeps its place in the registry
+            if(chunk == NULL){
+                chunk = evictLeastRecentlyUsed(stream,&savingQueued);
+                //the evicted chunk is still being written, this one is requested again next frame
+                //and the rest of the range gets the other chunks that can go
+                if(chunk == NULL && savingQueued){
+                    continue;
+                }
+            }
+            //budget is used up by chunks that are needed right now, try again next frame
+            if(chunk == NULL){
+                return;
+            }
+            //a reused chunk may still share its old tiles with a snapshot
+            if(!prepareChunkData(stream,chunk)){
+                fprintf(stderr,"Map stream error: out of memory for chunk tiles\n");
+                resourceRemove(chunk->resource);
+                chunk->state = MAP_CHUNK_FREE;
+                memPoolFree(&stream->chunkPool,chunk);
+                return;
+            }
+
+            chunk->chunkX = x;
+            chunk->chunkY = y;
+            chunk->state = MAP_CHUNK_LOADING;
+            chunk->dirty = 0;
+            chunk->lastUsedFrame = stream->frame;
+            stream->chunkTable[y*stream->chunksWide+x] = chunk;
+            if(stream->ioThread == NULL){
+                loadChunk(stream,chunk);
+                chunk->state = MAP_CHUNK_RESIDENT;
+                continue;
+            }
+            queuePush(&stream->pending,MAP_STREAM_REQUEST_LOAD,chunk,NULL);
+        }
+    }
+}
+
+void mapStreamUpdate(mapStreamT *stream,int minTileX,int minTileY,int maxTileX,int maxTileY)
+{
+    int minChunkX,minChunkY,maxChunkX,maxChunkY;
+    int centerX,centerY;
+    int dirX = 0,dirY = 0;
+
+    if(stream == NULL || stream->chunkTable == NULL){
+        return;
+    }
+    stream->frame++;
+
+    processCompletedRequests(stream);
+
+    minChunkX = minTileX>>MAP_CHUNK_SHIFT;
+    minChunkY = minTileY>>MAP_CHUNK_SHIFT;
+    maxChunkX = maxTileX>>MAP_CHUNK_SHIFT;
+    maxChunkY = maxTileY>>MAP_CHUNK_SHIFT;
+
+    //work out which way the camera is heading so we can prefetch in front of it
+    centerX = (minTileX+maxTileX)/2;
+    centerY = (minTileY+maxTileY)/2;
+    if(stream->hasLastCenter){
+        dirX = (centerX>stream->lastCenterX) - (centerX<stream->lastCenterX);
+        dirY = (centerY>stream->lastCenterY) - (centerY<stream->lastCenterY);
+    }
+    stream->lastCenterX = centerX;
+    stream->lastCenterY = centerY;
+    stream->hasLastCenter = 1;
+
+    if(stream->ioThread != NULL){
+        SDL_LockMutex(stream->ioLock);
+    }
+
+    //the visible chunks first, then the strip the camera is moving towards
+    requestChunkRange(stream,minChunkX,minChunkY,maxChunkX,maxChunkY);
+    if(dirX != 0 || dirY != 0){
+        requestChunkRange(stream,minChunkX+dirX*MAP_STREAM_PREFETCH_CHUNKS,minChunkY+dirY*MAP_STREAM_PREFETCH_CHUNKS,
+                          maxChunkX+dirX*MAP_STREAM_PREFETCH_CHUNKS,maxChunkY+dirY*MAP_STREAM_PREFETCH_CHUNKS);
+    }
+
+    if(stream->ioThread != NULL){
+        if(stream->pending.count>0){
+            SDL_CondSignal(stream->ioCond);
+        }
+        SDL_UnlockMutex(stream->ioLock);
+    }
+}
+
+//finishes loads, write-backs and saves without asking for new chunks, for frames that do not need the map
+void mapStreamPoll(mapStreamT *stream)
+{
+    if(stream == NULL || stream->chunkTable == NULL){
+        return;
+    }
+    processCompletedRequests(stream);
+}
+
+int mapStreamGetTile(mapStreamT *stream,int x,int y)
+{
+    mapChunkT *chunk;
+
+    if(x<0 || y<0 || x>=stream->mapWidth || y>=stream->mapHeight){
+        return MAP_TILE_NOT_LOADED;
+    }
+    chunk = stream->chunkTable[(y>>MAP_CHUNK_SHIFT)*stream->chunksWide+(x>>MAP_CHUNK_SHIFT)];
+    if(chunk == NULL || chunk->state != MAP_CHUNK_RESIDENT){
+        return MAP_TILE_NOT_LOADED;
+    }
+    return chunk->data->tiles[MAP_CHUNK_TILE_INDEX(x,y)];
+}
+
+int mapStreamSetTile(mapStreamT *stream,int x,int y,int tile)
+{
+    mapChunkT *chunk;
+    mapChunkDataT *copy;
+    int index;
+
+    if(x<0 || y<0 || x>=stream->mapWidth || y>=stream->mapHeight){
+        return 0;
+    }
+    index = (y>>MAP_CHUNK_SHIFT)*stream->chunksWide+(x>>MAP_CHUNK_SHIFT);
+    chunk = stream->chunkTable[index];
+    if(chunk == NULL || chunk->state != MAP_CHUNK_RESIDENT){
+        return 0;
+    }
+
+    //a snapshot that is still being written holds these tiles, leave them alone and change a copy
+    if(SDL_AtomicGet(&chunk->data->refCount)>1){
+        copy = memPoolAlloc(&stream->dataPool);
+        if(copy == NULL){
+            return 0;
+        }
+        SDL_AtomicSet(&copy->refCount,1);
+        memcpy(copy->tiles,chunk->data->tiles,MAP_CHUNK_TILES);
+        releaseChunkData(stream,chunk->data);
+        chunk->data = copy;
+        stream->numCopiedOnWrite++;
+    }
+    chunk->data->tiles[MAP_CHUNK_TILE_INDEX(x,y)] = (Uint8)tile;
+    chunk->dirty = 1;
+    markModified(stream,index);
+    return 1;
+}
+
+//O(changed chunks) on the main thread, the delta encoding and the disk are left to the I/O thread
+int mapStreamSave(mapStreamT *stream,const void *extra,int extraSize)
+{
+    mapSnapshotT *snapshot;
+    mapSnapshotChunkT *entry;
+    mapChunkT *chunk;
+    Uint64 start = SDL_GetPerformanceCounter();
+    int numShared = 0;
+    int i,index;
+
+    if(stream->ioThread == NULL){
+        fprintf(stderr,"Error in mapStreamSave(...): a map that only lives in memory can not be saved!\n");
+        return 0;
+    }
+    if(stream->snapshotInFlight != NULL){
+        fprintf(stderr,"Error in mapStreamSave(...): the last save is still being written!\n");
+        return 0;
+    }
+    if(extraSize<0 || extraSize>MAP_SAVE_MAX_EXTRA){
+        fprintf(stderr,"Error in mapStreamSave(...): no more than %d bytes of extra data!\n",MAP_SAVE_MAX_EXTRA);
+        return 0;
+    }
+
+    snapshot = calloc(1,sizeof(mapSnapshotT));
+    if(snapshot == NULL || (stream->numModified>0 &&
+       (snapshot->chunks = malloc(stream->numModified*sizeof(mapSnapshotChunkT))) == NULL)){
+        fprintf(stderr,"Error in mapStreamSave(...): out of memory!\n");
+        free(snapshot);
+        return 0;
+    }
+
+    for(i=0;i<stream->numModified;++i){
+        index = stream->modifiedChunks[i];
+        entry = &snapshot->chunks[i];
+        entry->chunkX = index%stream->chunksWide;
+        entry->chunkY = index/stream->chunksWide;
+        entry->data = NULL;
+
+        //chunks that are loading, saving or gone have their latest tiles in the file by the time the
+        //I/O thread gets to the snapshot, because it handles the requests in order
+        chunk = stream->chunkTable[index];
+        if(chunk != NULL && chunk->state == MAP_CHUNK_RESIDENT){
+            SDL_AtomicIncRef(&chunk->data->refCount);
+            entry->data = chunk->data;
+            numShared++;
+        }
+    }
+    snapshot->numChunks = stream->numModified;
+    clearModified(stream);
+
+    snapshot->saveNumber = ++stream->saveNumber;
+    if(extraSize>0){
+        memcpy(snapshot->extra,extra,extraSize);
+    }
+    snapshot->extraSize = extraSize;
+    //worst case every shared chunk is changed before it is written and has to be copied
+    snapshot->resource = resourceAdd(RESOURCE_MAP_CHUNKS,numShared*sizeof(mapChunkDataT),NULL,NULL,0);
+    snapshot->takenAt = SDL_GetPerformanceCounter();
+    snapshot->snapshotSeconds = (double)(snapshot->takenAt-start)/SDL_GetPerformanceFrequency();
+
+    SDL_LockMutex(stream->ioLock);
+    queuePush(&stream->pending,MAP_STREAM_REQUEST_SNAPSHOT,NULL,snapshot);
+    SDL_CondSignal(stream->ioCond);
+    SDL_UnlockMutex(stream->ioLock);
+    stream->snapshotInFlight = snapshot;
+    return 1;
+}
+
+int mapStreamIsSaving(mapStreamT *stream)
+{
+    return stream->snapshotInFlight != NULL;
+}
+
+//only before the first mapStreamUpdate(...), the chunk files are rewritten on the calling thread
+int mapStreamLoadSave(mapStreamT *stream,void *extra,int extraSize)
+{
+    if(stream->ioThread == NULL || stream->saveNumber == 0)
+    {
+        fprintf(stderr,"Error in mapStreamLoadSave(...): there is no save to load!\n");
+        return 0;
+    }
+    if(stream->chunkPool.numInUse>0)
+    {
+        fprintf(stderr,"Error in mapStreamLoadSave(...): chunks are already resident!\n");
+        return 0;
+    }
+    if(mapSaveRestore(stream,extra,extraSize)==0){
+        return 0;
+    }
+    clearModified(stream);
+    return 1;
+}
+
+int mapStreamNumModifiedChunks(mapStreamT *stream)
+{
+    return stream->numModified;
+}
+
+int mapStreamNumResidentChunks(mapStreamT *stream)
+{
+    int i;
+    int numResident = 0;
+    mapChunkT *chunk;
+    for(i=0;i<stream->chunkPool.numUsed;++i){
+        chunk = memPoolBlock(&stream->chunkPool,i);
+        if(chunk->state == MAP_CHUNK_RESIDENT){
+            numResident++;
+        }
+    }
+    return numResident;
+}
+
+void mapStreamClose(mapStreamT *stream)
+{
+    int i;
+    mapChunkT *chunk;
+    mapStreamRequestT request;
+
+    if(stream == NULL){
+        return;
+    }
+
+    if(stream->ioThread != NULL){
+        SDL_LockMutex(stream->ioLock);
+        stream->ioQuit = 1;
+        SDL_CondSignal(stream->ioCond);
+        SDL_UnlockMutex(stream->ioLock);
+        SDL_WaitThread(stream->ioThread,NULL);
+        stream->ioThread = NULL;
+
+        //a save written on the way out still has to be finished, or put back in the unsaved list if it failed
+        while(queuePop(&stream->completed,&request)){
+            if(request.type == MAP_STREAM_REQUEST_SNAPSHOT){
+                finishSnapshot(stream,request.snapshot);
+            }
+        }
+    }
+
+    //the I/O thread is gone, write back whatever is still dirty
+    for(i=0;i<stream->chunkPool.numUsed;++i){
+        chunk = memPoolBlock(&stream->chunkPool,i);
+        if(!isChunkInUse(chunk)){
+            continue;
+        }
+        if(chunk->state == MAP_CHUNK_RESIDENT && chunk->dirty && stream->directory[0] != '\0'){
+            saveChunk(stream,chunk);
+        }
+        resourceRemove(chunk->resource);
+        releaseChunkData(stream,chunk->data);
+    }
+    if(stream->directory[0] != '\0' && stream->modifiedBits != NULL){
+        writeUnsavedList(stream);
+    }
+
+    if(stream->ioCond != NULL){
+        SDL_DestroyCond(stream->ioCond);
+    }
+    if(stream->ioLock != NULL){
+        SDL_DestroyMutex(stream->ioLock);
+    }
+    memPoolClose(&stream->chunkPool);
+    memPoolClose(&stream->dataPool);
+    free(stream->chunkTable);
+    free(stream->modifiedBits);
+    free(stream->modifiedChunks);
+    free(stream->pending.requests);
+    free(stream->completed.requests);
+    memset(stream,0,sizeof(mapStreamT));
+}
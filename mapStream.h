@@ -0,0 +1,139 @@
+#ifndef MAPSTREAM_H_
+#define MAPSTREAM_H_
+#include <SDL2/SDL.h>
+#include "tileLayout.h"
+#include "memArena.h"
+
+#define MAP_CHUNK_SHIFT             5
+#define MAP_CHUNK_SIZE              (1<<MAP_CHUNK_SHIFT)
+#define MAP_CHUNK_TILES             (MAP_CHUNK_SIZE*MAP_CHUNK_SIZE)
+#define MAP_STREAM_PREFETCH_CHUNKS  2
+#define MAP_TILE_NOT_LOADED         -1
+#define MAP_SAVE_MAX_EXTRA          256
+
+//tiles inside a chunk are stored in Morton order, see tileLayout.h
+#define MAP_CHUNK_TILE_INDEX(x,y)   mortonEncode2D((x)&(MAP_CHUNK_SIZE-1),(y)&(MAP_CHUNK_SIZE-1))
+
+//chunk files start with a magic and a version, files without one are from before the Morton order
+//and hold the tiles row by row, they are converted when they are read
+#define MAP_CHUNK_FILE_MAGIC        0x4b4e4843
+#define MAP_CHUNK_FILE_VERSION      1
+
+#define MAP_CHUNK_FREE              0
+#define MAP_CHUNK_LOADING           1
+#define MAP_CHUNK_RESIDENT          2
+#define MAP_CHUNK_SAVING            3
+
+//fills a chunk that has no file on disk yet, called from the I/O thread
+//(or from mapStreamUpdate(...) when the stream has no directory and only lives in memory)
+typedef void (*mapChunkGeneratorT)(int chunkX,int chunkY,Uint8 *tiles);
+
+//the tiles of a chunk are shared with the snapshots that still have to be written,
+//a chunk that is changed while shared gets a copy of its own first (copy on write)
+typedef struct mapChunkDataT
+{
+    SDL_atomic_t refCount;
+    Uint8 tiles[MAP_CHUNK_TILES];
+}mapChunkDataT;
+
+typedef struct mapChunkT
+{
+    int chunkX;
+    int chunkY;
+    int state;
+    int dirty;
+    Uint32 lastUsedFrame;
+    int resource;
+    mapChunkDataT *data;
+}mapChunkT;
+
+typedef struct mapSnapshotChunkT
+{
+    int chunkX;
+    int chunkY;
+    //NULL when the chunk was not resident, the I/O thread reads it back from its file
+    mapChunkDataT *data;
+}mapSnapshotChunkT;
+
+//the chunks changed since the last save, as they were when the snapshot was taken
+typedef struct mapSnapshotT
+{
+    int saveNumber;
+    int numChunks;
+    mapSnapshotChunkT *chunks;
+    Uint8 extra[MAP_SAVE_MAX_EXTRA];
+    int extraSize;
+    int resource;
+    Uint64 takenAt;
+    double snapshotSeconds;
+    int bytesWritten;
+    int failed;
+}mapSnapshotT;
+
+typedef struct mapStreamRequestT
+{
+    int type;
+    mapChunkT *chunk;
+    mapSnapshotT *snapshot;
+}mapStreamRequestT;
+
+typedef struct mapStreamQueueT
+{
+    mapStreamRequestT *requests;
+    int capacity;
+    int head;
+    int count;
+}mapStreamQueueT;
+
+typedef struct mapStreamT
+{
+    int mapWidth;
+    int mapHeight;
+    int chunksWide;
+    int chunksHigh;
+    int maxResidentChunks;
+    memPoolT chunkPool;
+    memPoolT dataPool;
+    mapChunkT **chunkTable;
+    Uint32 frame;
+    int lastCenterX;
+    int lastCenterY;
+    int hasLastCenter;
+    char directory[256];
+    mapChunkGeneratorT generator;
+
+    SDL_Thread *ioThread;
+    SDL_mutex *ioLock;
+    SDL_cond *ioCond;
+    int ioQuit;
+    mapStreamQueueT pending;
+    mapStreamQueueT completed;
+
+    //chunks changed since the last save, kept in unsaved.lst between runs
+    Uint8 *modifiedBits;
+    int *modifiedChunks;
+    int numModified;
+    int modifiedCapacity;
+    int saveNumber;
+    mapSnapshotT *snapshotInFlight;
+    int numCopiedOnWrite;
+}mapStreamT;
+
+int mapStreamInit(mapStreamT *stream,int mapWidth,int mapHeight,int memoryBudgetInBytes,
+                  const char *directory,mapChunkGeneratorT generator);
+void mapStreamUpdate(mapStreamT *stream,int minTileX,int minTileY,int maxTileX,int maxTileY);
+void mapStreamPoll(mapStreamT *stream);
+int mapStreamGetTile(mapStreamT *stream,int x,int y);
+int mapStreamSetTile(mapStreamT *stream,int x,int y,int tile);
+int mapStreamNumResidentChunks(mapStreamT *stream);
+//reads a chunk straight from its file or the generator, ignoring what is resident
+void mapStreamReadChunk(mapStreamT *stream,int chunkX,int chunkY,Uint8 *tiles);
+//writes the file of a chunk, NULL tiles remove it so the chunk comes from the generator again
+int mapStreamWriteChunk(mapStreamT *stream,int chunkX,int chunkY,const Uint8 *tiles);
+int mapStreamSave(mapStreamT *stream,const void *extra,int extraSize);
+int mapStreamIsSaving(mapStreamT *stream);
+int mapStreamLoadSave(mapStreamT *stream,void *extra,int extraSize);
+int mapStreamNumModifiedChunks(mapStreamT *stream);
+void mapStreamClose(mapStreamT *stream);
+
+#endif // MAPSTREAM_H_
@@ -0,0 +1,164 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memArena.h"
+
+#define MEM_ALIGN_UP(size) (((size)+MEM_ALIGNMENT-1) & ~(MEM_ALIGNMENT-1))
+
+//filling dead memory in debug builds makes use-after-reset bugs show up straight away
+#ifdef MEM_ARENA_DEBUG
+#define MEM_DEAD_FILL(memory,size) memset((memory),0xcd,(size))
+#else
+#define MEM_DEAD_FILL(memory,size)
+#endif
+
+static Uint8 *alignPointer(Uint8 *memory)
+{
+    return (Uint8*)MEM_ALIGN_UP((size_t)memory);
+}
+
+int memArenaInit(memArenaT *arena,int size,const char *name)
+{
+    if(arena == NULL || size<=0)
+    {
+        fprintf(stderr,"Error in memArenaInit(...): bad parameters!\n");
+        return 0;
+    }
+    memset(arena,0,sizeof(memArenaT));
+    arena->name = name;
+    arena->size = MEM_ALIGN_UP(size);
+    arena->memory = malloc(arena->size+MEM_ALIGNMENT);
+    if(arena->memory == NULL){
+        fprintf(stderr,"Error in memArenaInit(...): could not allocate %d bytes for %s!\n",size,name);
+        return 0;
+    }
+    arena->base = alignPointer(arena->memory);
+    SDL_AtomicSet(&arena->offset,0);
+    MEM_DEAD_FILL(arena->base,arena->size);
+    return 1;
+}
+
+void *memArenaAlloc(memArenaT *arena,int size)
+{
+    int end;
+
+    size = MEM_ALIGN_UP(size);
+    end = SDL_AtomicAdd(&arena->offset,size)+size;
+    if(end>arena->size){
+        //the offset stays past the end, so every later allocation this frame fails too
+        SDL_AtomicAdd(&arena->numFailed,1);
+        return NULL;
+    }
+    return arena->base+end-size;
+}
+
+void memArenaReset(memArenaT *arena)
+{
+    int used = SDL_AtomicSet(&arena->offset,0);
+
+    if(used>arena->size){
+        used = arena->size;
+    }
+    if(used>arena->highWater){
+        arena->highWater = used;
+    }
+    MEM_DEAD_FILL(arena->base,used);
+}
+
+void memArenaPrintStats(memArenaT *arena)
+{
+    fprintf(stdout,"%s: high water %d of %d bytes (%.1f%%), %d failed allocations\n",arena->name,
+            arena->highWater,arena->size,100.0f*arena->highWater/arena->size,SDL_AtomicGet(&arena->numFailed));
+}
+
+void memArenaClose(memArenaT *arena)
+{
+    if(arena == NULL){
+        return;
+    }
+    free(arena->memory);
+    memset(arena,0,sizeof(memArenaT));
+}
+
+int memPoolInit(memPoolT *pool,int blockSize,int numBlocks,const char *name)
+{
+    if(pool == NULL || blockSize<=0 || numBlocks<=0)
+    {
+        fprintf(stderr,"Error in memPoolInit(...): bad parameters!\n");
+        return 0;
+    }
+    memset(pool,0,sizeof(memPoolT));
+    pool->name = name;
+    pool->blockSize = MEM_ALIGN_UP(blockSize);
+    pool->numBlocks = numBlocks;
+    pool->memory = calloc(1,(size_t)pool->blockSize*numBlocks+MEM_ALIGNMENT);
+    if(pool->memory == NULL){
+        fprintf(stderr,"Error in memPoolInit(...): could not allocate %d blocks for %s!\n",numBlocks,name);
+        return 0;
+    }
+    pool->base = alignPointer(pool->memory);
+    return 1;
+}
+
+void *memPoolAlloc(memPoolT *pool)
+{
+    void *block;
+
+    //recycled blocks first, then blocks that have never been handed out
+    if(pool->freeList != NULL){
+        block = pool->freeList;
+        pool->freeList = *(void**)block;
+    }
+    else if(pool->numUsed<pool->numBlocks){
+        block = pool->base+(size_t)pool->numUsed*pool->blockSize;
+        pool->numUsed++;
+    }
+    else{
+        return NULL;
+    }
+
+    pool->numInUse++;
+    if(pool->numInUse>pool->highWater){
+        pool->highWater = pool->numInUse;
+    }
+    return block;
+}
+
+void *memPoolBlock(memPoolT *pool,int index)
+{
+    return pool->base+(size_t)index*pool->blockSize;
+}
+
+void memPoolFree(memPoolT *pool,void *block)
+{
+    if(block == NULL){
+        return;
+    }
+    MEM_DEAD_FILL(block,pool->blockSize);
+    *(void**)block = pool->freeList;
+    pool->freeList = block;
+    pool->numInUse--;
+}
+
+void memPoolReset(memPoolT *pool)
+{
+    pool->freeList = NULL;
+    pool->numUsed = 0;
+    pool->numInUse = 0;
+}
+
+void memPoolPrintStats(memPoolT *pool)
+{
+    fprintf(stdout,"%s: high water %d of %d blocks of %d bytes\n",pool->name,
+            pool->highWater,pool->numBlocks,pool->blockSize);
+}
+
+void memPoolClose(memPoolT *pool)
+{
+    if(pool == NULL){
+        return;
+    }
+    free(pool->memory);
+    memset(pool,0,sizeof(memPoolT));
+}
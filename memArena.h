@@ -0,0 +1,50 @@
+#ifndef MEMARENA_H_
+#define MEMARENA_H_
+#include <SDL2/SDL.h>
+
+#define MEM_ALIGNMENT 16
+
+/*
+ *  Linear arena for data that only lives for one frame. Allocation is a single atomic
+ *  add so job threads can use it too, memArenaReset(...) throws everything away at once.
+ */
+typedef struct memArenaT
+{
+    Uint8 *base;
+    Uint8 *memory;
+    int size;
+    SDL_atomic_t offset;
+    int highWater;
+    SDL_atomic_t numFailed;
+    const char *name;
+}memArenaT;
+
+//fixed-size blocks with a free list, only the main thread may use a pool
+typedef struct memPoolT
+{
+    Uint8 *base;
+    Uint8 *memory;
+    int blockSize;
+    int numBlocks;
+    int numUsed;
+    int numInUse;
+    int highWater;
+    void *freeList;
+    const char *name;
+}memPoolT;
+
+int memArenaInit(memArenaT *arena,int size,const char *name);
+void *memArenaAlloc(memArenaT *arena,int size);
+void memArenaReset(memArenaT *arena);
+void memArenaPrintStats(memArenaT *arena);
+void memArenaClose(memArenaT *arena);
+
+int memPoolInit(memPoolT *pool,int blockSize,int numBlocks,const char *name);
+void *memPoolAlloc(memPoolT *pool);
+void *memPoolBlock(memPoolT *pool,int index);
+void memPoolFree(memPoolT *pool,void *block);
+void memPoolReset(memPoolT *pool);
+void memPoolPrintStats(memPoolT *pool);
+void memPoolClose(memPoolT *pool);
+
+#endif // MEMARENA_H_
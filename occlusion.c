@@ -0,0 +1,282 @@
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_image.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "occlusion.h"
+#include "renderer.h"
+#include "texture.h"
+
+#define OCCLUSION_CELLS_WIDE    ((WINDOW_WIDTH+OCCLUSION_CELL_SIZE-1)/OCCLUSION_CELL_SIZE)
+#define OCCLUSION_CELLS_HIGH    ((WINDOW_HEIGHT+OCCLUSION_CELL_SIZE-1)/OCCLUSION_CELL_SIZE)
+
+static int buildMask(occlusionMaskT *mask,SDL_Surface *surface,SDL_Rect *clip)
+{
+    int x,y;
+    int stride = clip->w+1;
+    Uint32 pixel;
+    Uint8 alpha;
+
+    mask->width = clip->w;
+    mask->height = clip->h;
+    mask->opaqueSum = calloc(stride*(clip->h+1),sizeof(Uint16));
+    mask->visibleSum = calloc(stride*(clip->h+1),sizeof(Uint16));
+    if(mask->opaqueSum == NULL || mask->visibleSum == NULL){
+        return 0;
+    }
+
+    for(y=0;y<clip->h;++y){
+        for(x=0;x<clip->w;++x){
+            alpha = 0;
+            if(clip->x+x < surface->w && clip->y+y < surface->h){
+                pixel = ((Uint32*)((Uint8*)surface->pixels+(clip->y+y)*surface->pitch))[clip->x+x];
+                alpha = pixel>>24;
+            }
+            mask->opaqueSum[(y+1)*stride+x+1] = (alpha==0xff)
+                + mask->opaqueSum[y*stride+x+1] + mask->opaqueSum[(y+1)*stride+x] - mask->opaqueSum[y*stride+x];
+            mask->visibleSum[(y+1)*stride+x+1] = (alpha!=0)
+                + mask->visibleSum[y*stride+x+1] + mask->visibleSum[(y+1)*stride+x] - mask->visibleSum[y*stride+x];
+        }
+    }
+    mask->numVisible = mask->visibleSum[clip->h*stride+clip->w];
+    return 1;
+}
+
+int occlusionInit(occlusionT *occlusion,char *filename,SDL_Rect *clipRects,int numClipRects)
+{
+    SDL_Surface *loadedSurface;
+    SDL_Surface *surface;
+    int i;
+
+    if(occlusion == NULL || numClipRects>OCCLUSION_MAX_TILES)
+    {
+        fprintf(stderr,"Error in occlusionInit(...): bad parameters!\n");
+        return 0;
+    }
+    memset(occlusion,0,sizeof(occlusionT));
+
+    //the texture only lives on the GPU, so read the alpha channel from the image file once more
+    loadedSurface = IMG_Load(filename);
+    if(loadedSurface == NULL){
+        fprintf(stderr,"Occlusion error: Could not load image:%s! SDL_image Error:%s\n",filename,IMG_GetError());
+        return 0;
+    }
+    surface = SDL_ConvertSurfaceFormat(loadedSurface,SDL_PIXELFORMAT_ARGB8888,0);
+    SDL_FreeSurface(loadedSurface);
+    if(surface == NULL){
+        fprintf(stderr,"Occlusion error: Could not convert image:%s! SDL Error:%s\n",filename,SDL_GetError());
+        return 0;
+    }
+
+    SDL_LockSurface(surface);
+    for(i=0;i<numClipRects;++i){
+        if(buildMask(&occlusion->masks[i],surface,&clipRects[i])==0){
+            fprintf(stderr,"Error in occlusionInit(...): out of memory!\n");
+            SDL_UnlockSurface(surface);
+            SDL_FreeSurface(surface);
+            occlusionClose(occlusion);
+            return 0;
+        }
+    }
+    SDL_UnlockSurface(surface);
+    SDL_FreeSurface(surface);
+
+    occlusion->numMasks = numClipRects;
+    occlusion->enabled = 1;
+    return 1;
+}
+
+static int rectSum(Uint16 *sum,occlusionMaskT *mask,int x0,int y0,int x1,int y1)
+{
+    int stride = mask->width+1;
+    return sum[y1*stride+x1] - sum[y0*stride+x1] - sum[y1*stride+x0] + sum[y0*stride+x0];
+}
+
+//the sprite pixels behind a screen rectangle, the sprite is stretched over the whole quad it is drawn into
+static void screenToSprite(occlusionMaskT *mask,SDL_Rect *quad,int screenX0,int screenY0,int screenX1,int screenY1,
+                           int *x0,int *y0,int *x1,int *y1)
+{
+    float scaleX = (float)mask->width/quad->w;
+    float scaleY = (float)mask->height/quad->h;
+
+    *x0 = (int)floorf((screenX0-quad->x)*scaleX);
+    *y0 = (int)floorf((screenY0-quad->y)*scaleY);
+    *x1 = (int)ceilf((screenX1-quad->x)*scaleX);
+    *y1 = (int)ceilf((screenY1-quad->y)*scaleY);
+}
+
+//the opaque test pads the range by a pixel to stay conservative about how the sprite is sampled
+static void cellToSprite(occlusionMaskT *mask,SDL_Rect *quad,int cellX,int cellY,int pad,int *x0,int *y0,int *x1,int *y1)
+{
+    int screenX = cellX<<OCCLUSION_CELL_SHIFT;
+    int screenY = cellY<<OCCLUSION_CELL_SHIFT;
+
+    screenToSprite(mask,quad,screenX,screenY,screenX+OCCLUSION_CELL_SIZE,screenY+OCCLUSION_CELL_SIZE,x0,y0,x1,y1);
+    *x0 -= pad;
+    *y0 -= pad;
+    *x1 += pad;
+    *y1 += pad;
+}
+
+//takes the padded range, the cell itself has to lie inside the sprite but the padding may hang over its edge
+static int isCellOpaque(occlusionMaskT *mask,int x0,int y0,int x1,int y1)
+{
+    if(x0<-1 || y0<-1 || x1>mask->width+1 || y1>mask->height+1){
+        return 0;
+    }
+    x0 = x0<0 ? 0 : x0;
+    y0 = y0<0 ? 0 : y0;
+    x1 = x1>mask->width ? mask->width : x1;
+    y1 = y1>mask->height ? mask->height : y1;
+    return rectSum(mask->opaqueSum,mask,x0,y0,x1,y1) == (x1-x0)*(y1-y0);
+}
+
+static int isCellVisible(occlusionMaskT *mask,int x0,int y0,int x1,int y1)
+{
+    x0 = x0<0 ? 0 : x0;
+    y0 = y0<0 ? 0 : y0;
+    x1 = x1>mask->width ? mask->width : x1;
+    y1 = y1>mask->height ? mask->height : y1;
+    if(x0>=x1 || y0>=y1){
+        return 0;
+    }
+    return rectSum(mask->visibleSum,mask,x0,y0,x1,y1) > 0;
+}
+
+//the screen pixels the sprite fills inside the window, what it costs to draw it
+static float visiblePixelsOnScreen(occlusionMaskT *mask,SDL_Rect *quad)
+{
+    int screenX0 = quad->x<0 ? 0 : quad->x;
+    int screenY0 = quad->y<0 ? 0 : quad->y;
+    int screenX1 = quad->x+quad->w>WINDOW_WIDTH ? WINDOW_WIDTH : quad->x+quad->w;
+    int screenY1 = quad->y+quad->h>WINDOW_HEIGHT ? WINDOW_HEIGHT : quad->y+quad->h;
+    int x0,y0,x1,y1;
+
+    if(screenX0>=screenX1 || screenY0>=screenY1 || mask->width==0 || mask->height==0){
+        return 0;
+    }
+    screenToSprite(mask,quad,screenX0,screenY0,screenX1,screenY1,&x0,&y0,&x1,&y1);
+    x0 = x0<0 ? 0 : x0;
+    y0 = y0<0 ? 0 : y0;
+    x1 = x1>mask->width ? mask->width : x1;
+    y1 = y1>mask->height ? mask->height : y1;
+    return rectSum(mask->visibleSum,mask,x0,y0,x1,y1)*((float)quad->w*quad->h/(mask->width*mask->height));
+}
+
+void occlusionCull(occlusionT *occlusion,occlusionTileT *tiles,int numTiles,float scale,memArenaT *frameArena)
+{
+    Uint8 *covered = NULL;
+    occlusionTileT *tile;
+    occlusionMaskT *mask;
+    int i,cellX,cellY;
+    int minCellX,minCellY,maxCellX,maxCellY;
+    int x0,y0,x1,y1;
+    SDL_Rect spriteRect;
+    SDL_Rect quad;
+    float pixels;
+    float tilePixels = 0,submittedPixels = 0;
+
+    if(occlusion->enabled && occlusion->numMasks>0){
+        covered = memArenaAlloc(frameArena,OCCLUSION_CELLS_WIDE*OCCLUSION_CELLS_HIGH);
+    }
+    if(covered != NULL){
+        memset(covered,0,OCCLUSION_CELLS_WIDE*OCCLUSION_CELLS_HIGH);
+    }
+
+    occlusion->numCandidates = numTiles;
+    occlusion->numSubmitted = 0;
+
+    //the tiles come in back to front order, so walk them backwards to see the front ones first
+    for(i=numTiles-1;i>=0;--i){
+        tile = &tiles[i];
+        tile->visible = 1;
+        if(tile->tile<0 || tile->tile>=occlusion->numMasks){
+            occlusion->numSubmitted++;
+            continue;
+        }
+        mask = &occlusion->masks[tile->tile];
+        //the same rounded quad that gets drawn, a rectangle worked out from the scale alone misses its padding
+        spriteRect.x = 0;
+        spriteRect.y = 0;
+        spriteRect.w = mask->width;
+        spriteRect.h = mask->height;
+        textureClipScaleQuad(tile->x,tile->y,&spriteRect,scale,&quad);
+        if(quad.w<=0 || quad.h<=0){
+            tile->visible = 0;
+            continue;
+        }
+        pixels = visiblePixelsOnScreen(mask,&quad);
+        tilePixels += pixels;
+
+        if(covered != NULL){
+            minCellX = quad.x>>OCCLUSION_CELL_SHIFT;
+            minCellY = quad.y>>OCCLUSION_CELL_SHIFT;
+            maxCellX = (quad.x+quad.w-1)>>OCCLUSION_CELL_SHIFT;
+            maxCellY = (quad.y+quad.h-1)>>OCCLUSION_CELL_SHIFT;
+            minCellX = minCellX<0 ? 0 : minCellX;
+            minCellY = minCellY<0 ? 0 : minCellY;
+            maxCellX = maxCellX>=OCCLUSION_CELLS_WIDE ? OCCLUSION_CELLS_WIDE-1 : maxCellX;
+            maxCellY = maxCellY>=OCCLUSION_CELLS_HIGH ? OCCLUSION_CELLS_HIGH-1 : maxCellY;
+
+            //hidden when every screen cell the sprite puts a pixel into is already covered
+            tile->visible = 0;
+            for(cellY=minCellY;cellY<=maxCellY && !tile->visible;++cellY){
+                for(cellX=minCellX;cellX<=maxCellX;++cellX){
+                    if(covered[cellY*OCCLUSION_CELLS_WIDE+cellX]){
+                        continue;
+                    }
+                    cellToSprite(mask,&quad,cellX,cellY,0,&x0,&y0,&x1,&y1);
+                    if(isCellVisible(mask,x0,y0,x1,y1)){
+                        tile->visible = 1;
+                        break;
+                    }
+                }
+            }
+            if(!tile->visible){
+                continue;
+            }
+
+            for(cellY=minCellY;cellY<=maxCellY;++cellY){
+                for(cellX=minCellX;cellX<=maxCellX;++cellX){
+                    cellToSprite(mask,&quad,cellX,cellY,1,&x0,&y0,&x1,&y1);
+                    if(isCellOpaque(mask,x0,y0,x1,y1)){
+                        covered[cellY*OCCLUSION_CELLS_WIDE+cellX] = 1;
+                    }
+                }
+            }
+        }
+        occlusion->numSubmitted++;
+        submittedPixels += pixels;
+    }
+
+    occlusion->overdrawCandidates = tilePixels/(WINDOW_WIDTH*WINDOW_HEIGHT);
+    occlusion->overdrawSubmitted = submittedPixels/(WINDOW_WIDTH*WINDOW_HEIGHT);
+    occlusion->totalOverdrawCandidates += occlusion->overdrawCandidates;
+    occlusion->totalOverdrawSubmitted += occlusion->overdrawSubmitted;
+    occlusion->numFrames++;
+}
+
+void occlusionPrintStats(occlusionT *occlusion)
+{
+    if(occlusion->numFrames==0){
+        return;
+    }
+    fprintf(stdout,"tile overdraw: %.2fx without culling, %.2fx submitted (average over %d frames)\n",
+            occlusion->totalOverdrawCandidates/occlusion->numFrames,
+            occlusion->totalOverdrawSubmitted/occlusion->numFrames,occlusion->numFrames);
+}
+
+void occlusionClose(occlusionT *occlusion)
+{
+    int i;
+
+    if(occlusion == NULL){
+        return;
+    }
+    for(i=0;i<OCCLUSION_MAX_TILES;++i){
+        free(occlusion->masks[i].opaqueSum);
+        free(occlusion->masks[i].visibleSum);
+    }
+    memset(occlusion,0,sizeof(occlusionT));
+}
@@ -0,0 +1,52 @@
+#ifndef OCCLUSION_H_
+#define OCCLUSION_H_
+#include <SDL2/SDL.h>
+#include "memArena.h"
+
+#define OCCLUSION_MAX_TILES     16
+#define OCCLUSION_CELL_SHIFT    3
+#define OCCLUSION_CELL_SIZE     (1<<OCCLUSION_CELL_SHIFT)
+
+/*
+ *  Summed area tables over the alpha channel of one tile sprite, so the culling pass can
+ *  ask "is this rectangle of the sprite fully opaque / completely empty" in constant time.
+ */
+typedef struct occlusionMaskT
+{
+    int width;
+    int height;
+    Uint16 *opaqueSum;
+    Uint16 *visibleSum;
+    int numVisible;
+}occlusionMaskT;
+
+typedef struct occlusionTileT
+{
+    int x;
+    int y;
+    int tile;
+    int visible;
+}occlusionTileT;
+
+typedef struct occlusionT
+{
+    occlusionMaskT masks[OCCLUSION_MAX_TILES];
+    int numMasks;
+    int enabled;
+
+    //overdraw is the number of tile pixels filled inside the window divided by the pixels of the window
+    float overdrawSubmitted;
+    float overdrawCandidates;
+    int numSubmitted;
+    int numCandidates;
+    double totalOverdrawSubmitted;
+    double totalOverdrawCandidates;
+    int numFrames;
+}occlusionT;
+
+int occlusionInit(occlusionT *occlusion,char *filename,SDL_Rect *clipRects,int numClipRects);
+void occlusionCull(occlusionT *occlusion,occlusionTileT *tiles,int numTiles,float scale,memArenaT *frameArena);
+void occlusionPrintStats(occlusionT *occlusion);
+void occlusionClose(occlusionT *occlusion);
+
+#endif // OCCLUSION_H_
@@ -0,0 +1,404 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "particles.h"
+#include "renderer.h"
+#include "jobs.h"
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define PARTICLES_USE_SSE
+#endif
+
+#define PARTICLE_DEFAULT_LIFETIME   1.5f
+#define PARTICLE_DEFAULT_SPEED      20.0f
+#define PARTICLE_DEFAULT_RISE       60.0f
+#define PARTICLE_DEFAULT_SIZE       4.0f
+#define PARTICLE_DEFAULT_GRAVITY    90.0f
+
+static float randomFloat(particleSystemT *particles)
+{
+    //xorshift32, cheap and good enough for effects
+    Uint32 state = particles->randomState;
+    state ^= state<<13;
+    state ^= state>>17;
+    state ^= state<<5;
+    particles->randomState = state;
+    return (state>>8)*(1.0f/16777216.0f);
+}
+
+int particleSystemInit(particleSystemT *particles,int capacity)
+{
+    int i;
+
+    if(particles == NULL || capacity<=0)
+    {
+        fprintf(stderr,"Error in particleSystemInit(...): bad parameters!\n");
+        return 0;
+    }
+    memset(particles,0,sizeof(particleSystemT));
+    particles->capacity = capacity;
+    particles->gravity = PARTICLE_DEFAULT_GRAVITY;
+    particles->randomState = 0x9e3779b9;
+
+    particles->x = malloc(capacity*sizeof(float));
+    particles->y = malloc(capacity*sizeof(float));
+    particles->z = malloc(capacity*sizeof(float));
+    particles->vx = malloc(capacity*sizeof(float));
+    particles->vy = malloc(capacity*sizeof(float));
+    particles->vz = malloc(capacity*sizeof(float));
+    particles->life = malloc(capacity*sizeof(float));
+    particles->invLifetime = malloc(capacity*sizeof(float));
+    particles->size = malloc(capacity*sizeof(float));
+    particles->color = malloc(capacity*sizeof(Uint32));
+    particles->emitter = malloc(capacity*sizeof(Uint16));
+    particles->indices = malloc(capacity*6*sizeof(int));
+
+    if(particles->x == NULL || particles->y == NULL || particles->z == NULL ||
+       particles->vx == NULL || particles->vy == NULL || particles->vz == NULL ||
+       particles->life == NULL || particles->invLifetime == NULL || particles->size == NULL ||
+       particles->color == NULL || particles->emitter == NULL || particles->indices == NULL)
+    {
+        fprintf(stderr,"Error in particleSystemInit(...): out of memory!\n");
+        particleSystemClose(particles);
+        return 0;
+    }
+
+    //every particle is a quad, so the index buffer never changes
+    for(i=0;i<capacity;++i){
+        particles->indices[i*6+0] = i*4+0;
+        particles->indices[i*6+1] = i*4+1;
+        particles->indices[i*6+2] = i*4+2;
+        particles->indices[i*6+3] = i*4+0;
+        particles->indices[i*6+4] = i*4+2;
+        particles->indices[i*6+5] = i*4+3;
+    }
+    return 1;
+}
+
+static int addEmitter(particleSystemT *particles,int attachType,float rate,SDL_Rect *sourceRect,SDL_Color color)
+{
+    int i;
+    particleEmitterT *emitter;
+
+    for(i=0;i<PARTICLE_MAX_EMITTERS;++i){
+        emitter = &particles->emitters[i];
+        if(emitter->rate<=0){
+            memset(emitter,0,sizeof(particleEmitterT));
+            emitter->active = 1;
+            emitter->attachType = attachType;
+            emitter->rate = rate;
+            emitter->lifetime = PARTICLE_DEFAULT_LIFETIME;
+            emitter->speed = PARTICLE_DEFAULT_SPEED;
+            emitter->riseSpeed = PARTICLE_DEFAULT_RISE;
+            emitter->size = PARTICLE_DEFAULT_SIZE;
+            emitter->color = color;
+            emitter->sourceRect = *sourceRect;
+            return i;
+        }
+    }
+    fprintf(stderr,"Particle warning: all %d emitters are in use\n",PARTICLE_MAX_EMITTERS);
+    return -1;
+}
+
+int particleAddTileEmitter(particleSystemT *particles,int tileX,int tileY,float rate,SDL_Rect *sourceRect,SDL_Color color)
+{
+    int emitter = addEmitter(particles,PARTICLE_ATTACH_TILE,rate,sourceRect,color);
+    if(emitter>=0){
+        particles->emitters[emitter].tileX = tileX;
+        particles->emitters[emitter].tileY = tileY;
+    }
+    return emitter;
+}
+
+int particleAddEntityEmitter(particleSystemT *particles,point2DT *entity,float rate,SDL_Rect *sourceRect,SDL_Color color)
+{
+    int emitter = addEmitter(particles,PARTICLE_ATTACH_ENTITY,rate,sourceRect,color);
+    if(emitter>=0){
+        particles->emitters[emitter].entity = entity;
+    }
+    return emitter;
+}
+
+void particleSetEmitterActive(particleSystemT *particles,int emitter,int active)
+{
+    if(emitter>=0 && emitter<PARTICLE_MAX_EMITTERS){
+        particles->emitters[emitter].active = active;
+    }
+}
+
+//offset in world pixels from the tile centre or entity position
+void particleSetEmitterOffset(particleSystemT *particles,int emitter,float x,float y)
+{
+    if(emitter>=0 && emitter<PARTICLE_MAX_EMITTERS){
+        particles->emitters[emitter].offset.x = x;
+        particles->emitters[emitter].offset.y = y;
+    }
+}
+
+void particleRemoveEmitter(particleSystemT *particles,int emitter)
+{
+    //only stops spawning, the particles already in flight live out their lifetime
+    if(emitter>=0 && emitter<PARTICLE_MAX_EMITTERS){
+        particles->emitters[emitter].active = 0;
+        particles->emitters[emitter].rate = 0;
+    }
+}
+
+static void spawnParticles(particleSystemT *particles,int emitterIndex,float deltaTime)
+{
+    particleEmitterT *emitter = &particles->emitters[emitterIndex];
+    float originX,originY;
+    float angle,speed;
+    int count,i;
+
+    emitter->spawnAccumulator += emitter->rate*deltaTime;
+    count = (int)emitter->spawnAccumulator;
+    emitter->spawnAccumulator -= count;
+
+    if(emitter->attachType == PARTICLE_ATTACH_TILE){
+        originX = (emitter->tileX+0.5f)*TILESIZE;
+        originY = (emitter->tileY+0.5f)*TILESIZE;
+    }
+    else{
+        originX = emitter->entity->x;
+        originY = emitter->entity->y;
+    }
+    originX += emitter->offset.x;
+    originY += emitter->offset.y;
+
+    while(count>0 && particles->numParticles<particles->capacity){
+        i = particles->numParticles++;
+        angle = randomFloat(particles)*6.2831853f;
+        speed = emitter->speed*randomFloat(particles);
+        particles->x[i] = originX;
+        particles->y[i] = originY;
+        particles->z[i] = 0;
+        particles->vx[i] = cosf(angle)*speed;
+        particles->vy[i] = sinf(angle)*speed;
+        particles->vz[i] = emitter->riseSpeed*(0.5f+0.5f*randomFloat(particles));
+        particles->life[i] = emitter->lifetime*(0.5f+0.5f*randomFloat(particles));
+        particles->invLifetime[i] = 1.0f/particles->life[i];
+        particles->size[i] = emitter->size;
+        particles->color[i] = ((Uint32)emitter->color.r<<24) | ((Uint32)emitter->color.g<<16) | ((Uint32)emitter->color.b<<8) | emitter->color.a;
+        particles->emitter[i] = emitterIndex;
+        count--;
+    }
+}
+
+//no branches and no aliasing, four particles per step when SSE is available
+static void integrateParticles(float * restrict x,float * restrict y,float * restrict z,
+                               const float * restrict vx,const float * restrict vy,float * restrict vz,
+                               float * restrict life,int count,float deltaTime,float gravity)
+{
+    int i = 0;
+#ifdef PARTICLES_USE_SSE
+    __m128 dt = _mm_set1_ps(deltaTime);
+    __m128 fall = _mm_set1_ps(gravity*deltaTime);
+    __m128 zero = _mm_setzero_ps();
+    __m128 velocityZ;
+
+    for(;i+4<=count;i+=4){
+        velocityZ = _mm_sub_ps(_mm_loadu_ps(&vz[i]),fall);
+        _mm_storeu_ps(&vz[i],velocityZ);
+        _mm_storeu_ps(&x[i],_mm_add_ps(_mm_loadu_ps(&x[i]),_mm_mul_ps(_mm_loadu_ps(&vx[i]),dt)));
+        _mm_storeu_ps(&y[i],_mm_add_ps(_mm_loadu_ps(&y[i]),_mm_mul_ps(_mm_loadu_ps(&vy[i]),dt)));
+        _mm_storeu_ps(&z[i],_mm_max_ps(_mm_add_ps(_mm_loadu_ps(&z[i]),_mm_mul_ps(velocityZ,dt)),zero));
+        _mm_storeu_ps(&life[i],_mm_sub_ps(_mm_loadu_ps(&life[i]),dt));
+    }
+#endif
+    for(;i<count;++i){
+        vz[i] -= gravity*deltaTime;
+        x[i] += vx[i]*deltaTime;
+        y[i] += vy[i]*deltaTime;
+        z[i] += vz[i]*deltaTime;
+        z[i] = z[i]<0.0f ? 0.0f : z[i];
+        life[i] -= deltaTime;
+    }
+}
+
+static void integrateParticleRange(void *data,int start,int end)
+{
+    particleSystemT *particles = (particleSystemT*)data;
+    integrateParticles(&particles->x[start],&particles->y[start],&particles->z[start],
+                       &particles->vx[start],&particles->vy[start],&particles->vz[start],
+                       &particles->life[start],end-start,particles->stepTime,particles->gravity);
+}
+
+static void removeDeadParticles(particleSystemT *particles)
+{
+    int i = 0;
+    int last;
+
+    //swap the last live particle into every dead slot, the pool stays packed
+    while(i<particles->numParticles){
+        if(particles->life[i]>0){
+            ++i;
+            continue;
+        }
+        last = --particles->numParticles;
+        particles->x[i] = particles->x[last];
+        particles->y[i] = particles->y[last];
+        particles->z[i] = particles->z[last];
+        particles->vx[i] = particles->vx[last];
+        particles->vy[i] = particles->vy[last];
+        particles->vz[i] = particles->vz[last];
+        particles->life[i] = particles->life[last];
+        particles->invLifetime[i] = particles->invLifetime[last];
+        particles->size[i] = particles->size[last];
+        particles->color[i] = particles->color[last];
+        particles->emitter[i] = particles->emitter[last];
+    }
+}
+
+void particleSystemUpdate(particleSystemT *particles,float deltaTime)
+{
+    int i;
+    jobCounterT counter;
+
+    for(i=0;i<PARTICLE_MAX_EMITTERS;++i){
+        if(particles->emitters[i].active && particles->emitters[i].rate>0){
+            spawnParticles(particles,i,deltaTime);
+        }
+    }
+
+    particles->stepTime = deltaTime;
+    jobCounterInit(&counter);
+    jobParallelFor(integrateParticleRange,particles,particles->numParticles,PARTICLE_JOB_GRAIN,&counter);
+    jobWait(&counter);
+
+    removeDeadParticles(particles);
+}
+
+static void sortParticlesByDepth(particleSystemT *particles,Uint32 *sortKeys,int *drawOrder)
+{
+    int i,bucket;
+    float depth,minDepth,maxDepth,bucketScale;
+    int *counts = particles->depthCounts;
+
+    if(particles->numParticles==0){
+        return;
+    }
+
+    //in isometric space everything on the same x+y diagonal is at the same depth
+    minDepth = maxDepth = particles->x[0]+particles->y[0];
+    for(i=1;i<particles->numParticles;++i){
+        depth = particles->x[i]+particles->y[i];
+        minDepth = depth<minDepth ? depth : minDepth;
+        maxDepth = depth>maxDepth ? depth : maxDepth;
+    }
+    bucketScale = maxDepth>minDepth ? (PARTICLE_DEPTH_BUCKETS-1)/(maxDepth-minDepth) : 0;
+
+    //counting sort, linear in the number of particles
+    memset(counts,0,sizeof(particles->depthCounts));
+    for(i=0;i<particles->numParticles;++i){
+        bucket = (int)((particles->x[i]+particles->y[i]-minDepth)*bucketScale);
+        sortKeys[i] = bucket;
+        counts[bucket+1]++;
+    }
+    for(i=1;i<=PARTICLE_DEPTH_BUCKETS;++i){
+        counts[i] += counts[i-1];
+    }
+    for(i=0;i<particles->numParticles;++i){
+        drawOrder[counts[sortKeys[i]]++] = i;
+    }
+}
+
+void particleSystemDraw(particleSystemT *particles,isoEngineT *isoEngine,textureT *atlas,float zoomLevel,memArenaT *frameArena)
+{
+    int n,i;
+    float worldX,worldY,screenX,screenY,size;
+    float invWidth,invHeight;
+    float textureCoords[PARTICLE_MAX_EMITTERS][4];
+    float *uv;
+    Uint32 color;
+    SDL_Color vertexColor;
+    SDL_Rect *source;
+    SDL_Vertex *vertex;
+    SDL_Vertex *vertices;
+    Uint32 *sortKeys;
+    int *drawOrder;
+
+    if(particles == NULL || atlas == NULL || atlas->width<=0 || atlas->height<=0 || particles->numParticles==0){
+        return;
+    }
+
+    sortKeys = memArenaAlloc(frameArena,particles->numParticles*sizeof(Uint32));
+    drawOrder = memArenaAlloc(frameArena,particles->numParticles*sizeof(int));
+    vertices = memArenaAlloc(frameArena,particles->numParticles*4*sizeof(SDL_Vertex));
+    if(sortKeys == NULL || drawOrder == NULL || vertices == NULL){
+        return;
+    }
+
+    sortParticlesByDepth(particles,sortKeys,drawOrder);
+
+    invWidth = 1.0f/atlas->width;
+    invHeight = 1.0f/atlas->height;
+    for(i=0;i<PARTICLE_MAX_EMITTERS;++i){
+        source = &particles->emitters[i].sourceRect;
+        textureCoords[i][0] = source->x*invWidth;
+        textureCoords[i][1] = source->y*invHeight;
+        textureCoords[i][2] = (source->x+source->w)*invWidth;
+        textureCoords[i][3] = (source->y+source->h)*invHeight;
+    }
+    particles->numDrawn = 0;
+
+    for(n=0;n<particles->numParticles;++n){
+        i = drawOrder[n];
+
+        //same projection as the tiles, the sprite origin sits one tile to the right of the iso point
+        worldX = particles->x[i]*zoomLevel + isoEngine->scrollX;
+        worldY = particles->y[i]*zoomLevel + isoEngine->scrollY;
+        screenX = worldX - worldY + TILESIZE*zoomLevel;
+        screenY = (worldX + worldY)*0.5f - particles->z[i]*zoomLevel;
+        size = particles->size[i]*zoomLevel;
+
+        if(screenX+size<0 || screenY+size<0 || screenX>WINDOW_WIDTH || screenY>WINDOW_HEIGHT){
+            continue;
+        }
+
+        uv = textureCoords[particles->emitter[i]];
+
+        color = particles->color[i];
+        vertexColor.r = color>>24;
+        vertexColor.g = (color>>16)&0xff;
+        vertexColor.b = (color>>8)&0xff;
+        vertexColor.a = (Uint8)((color&0xff)*particles->life[i]*particles->invLifetime[i]);
+
+        vertex = &vertices[particles->numDrawn*4];
+        vertex[0].position.x = screenX;        vertex[0].position.y = screenY;
+        vertex[1].position.x = screenX+size;   vertex[1].position.y = screenY;
+        vertex[2].position.x = screenX+size;   vertex[2].position.y = screenY+size;
+        vertex[3].position.x = screenX;        vertex[3].position.y = screenY+size;
+        vertex[0].tex_coord.x = uv[0];         vertex[0].tex_coord.y = uv[1];
+        vertex[1].tex_coord.x = uv[2];         vertex[1].tex_coord.y = uv[1];
+        vertex[2].tex_coord.x = uv[2];         vertex[2].tex_coord.y = uv[3];
+        vertex[3].tex_coord.x = uv[0];         vertex[3].tex_coord.y = uv[3];
+        vertex[0].color = vertex[1].color = vertex[2].color = vertex[3].color = vertexColor;
+        particles->numDrawn++;
+    }
+
+    //one draw call for every particle on screen
+    textureRenderQuadBatch(atlas,vertices,particles->indices,particles->numDrawn);
+}
+
+void particleSystemClose(particleSystemT *particles)
+{
+    if(particles == NULL){
+        return;
+    }
+    free(particles->x);
+    free(particles->y);
+    free(particles->z);
+    free(particles->vx);
+    free(particles->vy);
+    free(particles->vz);
+    free(particles->life);
+    free(particles->invLifetime);
+    free(particles->size);
+    free(particles->color);
+    free(particles->emitter);
+    free(particles->indices);
+    memset(particles,0,sizeof(particleSystemT));
+}
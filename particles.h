@@ -0,0 +1,74 @@
+#ifndef PARTICLES_H_
+#define PARTICLES_H_
+#include <SDL2/SDL.h>
+#include "isoEngine.h"
+#include "texture.h"
+#include "memArena.h"
+
+#define PARTICLE_MAX_EMITTERS       64
+#define PARTICLE_DEPTH_BUCKETS      4096
+#define PARTICLE_JOB_GRAIN          16384
+
+#define PARTICLE_ATTACH_TILE        0
+#define PARTICLE_ATTACH_ENTITY      1
+
+typedef struct particleEmitterT
+{
+    int active;
+    int attachType;
+    int tileX;
+    int tileY;
+    point2DT *entity;
+    point2DT offset;
+    float rate;
+    float spawnAccumulator;
+    float lifetime;
+    float speed;
+    float riseSpeed;
+    float size;
+    SDL_Color color;
+    SDL_Rect sourceRect;
+}particleEmitterT;
+
+/*
+ *  Particles are kept as a struct of arrays so the update kernel runs over
+ *  plain float streams, positions are cartesian world pixels (same space as
+ *  the character) plus a height above the ground.
+ */
+typedef struct particleSystemT
+{
+    int capacity;
+    int numParticles;
+    float *x;
+    float *y;
+    float *z;
+    float *vx;
+    float *vy;
+    float *vz;
+    float *life;
+    float *invLifetime;
+    float *size;
+    Uint32 *color;
+    Uint16 *emitter;
+    float gravity;
+    float stepTime;
+    Uint32 randomState;
+    particleEmitterT emitters[PARTICLE_MAX_EMITTERS];
+
+    //the sort and vertex buffers come from the frame arena, only the index pattern is kept
+    int depthCounts[PARTICLE_DEPTH_BUCKETS+1];
+    int *indices;
+    int numDrawn;
+}particleSystemT;
+
+int particleSystemInit(particleSystemT *particles,int capacity);
+int particleAddTileEmitter(particleSystemT *particles,int tileX,int tileY,float rate,SDL_Rect *sourceRect,SDL_Color color);
+int particleAddEntityEmitter(particleSystemT *particles,point2DT *entity,float rate,SDL_Rect *sourceRect,SDL_Color color);
+void particleSetEmitterActive(particleSystemT *particles,int emitter,int active);
+void particleSetEmitterOffset(particleSystemT *particles,int emitter,float x,float y);
+void particleRemoveEmitter(particleSystemT *particles,int emitter);
+void particleSystemUpdate(particleSystemT *particles,float deltaTime);
+void particleSystemDraw(particleSystemT *particles,isoEngineT *isoEngine,textureT *atlas,float zoomLevel,memArenaT *frameArena);
+void particleSystemClose(particleSystemT *particles);
+
+#endif // PARTICLES_H_
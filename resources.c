@@ -0,0 +1,347 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "resources.h"
+
+#define RESOURCE_FREE -1
+
+typedef struct resourceEntryT
+{
+    int category;
+    Sint64 size;
+    Uint32 lastUsed;
+    resourceEvictFunctionT evict;
+    void *owner;
+    int handle;
+    //next free entry while category is RESOURCE_FREE
+    int nextFree;
+}resourceEntryT;
+
+typedef struct resourceCategoryT
+{
+    const char *name;
+    Sint64 usage;
+    Sint64 peak;
+    Sint64 budget;
+    int count;
+    int numEvicted;
+    int warnedOverBudget;
+}resourceCategoryT;
+
+static SDL_SpinLock lock = 0;
+static resourceEntryT *entries = NULL;
+static int numEntries = 0;
+static int capacity = 0;
+static int firstFree = -1;
+static Uint32 useCounter = 0;
+static resourceCategoryT categories[RESOURCE_NUM_CATEGORIES] = {
+    {"textures",0,0,0,0,0,0},
+    {"surfaces",0,0,0,0,0,0},
+    {"chunks",0,0,0,0,0,0},
+    {"sprites",0,0,0,0,0,0},
+    {"lod",0,0,0,0,0,0}
+};
+
+static int isValid(int resource)
+{
+    return resource>=0 && resource<numEntries && entries[resource].category != RESOURCE_FREE;
+}
+
+static void removeEntry(int resource)
+{
+    resourceEntryT *entry = &entries[resource];
+    resourceCategoryT *category = &categories[entry->category];
+
+    category->usage -= entry->size;
+    category->count--;
+    entry->category = RESOURCE_FREE;
+    entry->evict = NULL;
+    entry->nextFree = firstFree;
+    firstFree = resource;
+}
+
+//takes the least recently touched evictable entry of the category out of the registry
+static int popLeastRecentlyUsed(int category,resourceEntryT *victim)
+{
+    int i;
+    int oldest = -1;
+
+    for(i=0;i<numEntries;++i){
+        if(entries[i].category == category && entries[i].evict != NULL &&
+           (oldest<0 || (Sint32)(entries[i].lastUsed-entries[oldest].lastUsed)<0)){
+            oldest = i;
+        }
+    }
+    if(oldest<0){
+        return 0;
+    }
+    *victim = entries[oldest];
+    removeEntry(oldest);
+    categories[category].numEvicted++;
+    return 1;
+}
+
+void resourceSetBudget(int category,Sint64 budgetInBytes)
+{
+    resourceEntryT victim;
+
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES){
+        return;
+    }
+    SDL_AtomicLock(&lock);
+    categories[category].budget = budgetInBytes;
+    categories[category].warnedOverBudget = 0;
+    SDL_AtomicUnlock(&lock);
+
+    //a smaller budget takes effect right away
+    while(1){
+        SDL_AtomicLock(&lock);
+        if(budgetInBytes<=0 || categories[category].usage<=budgetInBytes || !popLeastRecentlyUsed(category,&victim)){
+            SDL_AtomicUnlock(&lock);
+            break;
+        }
+        SDL_AtomicUnlock(&lock);
+        victim.evict(victim.owner,victim.handle);
+    }
+}
+
+int resourceFindCategory(const char *name)
+{
+    int i;
+    for(i=0;i<RESOURCE_NUM_CATEGORIES;++i){
+        if(strcmp(categories[i].name,name)==0){
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char *resourceCategoryName(int category)
+{
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES){
+        return "unknown";
+    }
+    return categories[category].name;
+}
+
+//mayExceed lets an entry that is only counted go over the budget once nothing is left to evict
+static int addEntry(int category,Sint64 size,resourceEvictFunctionT evict,void *owner,int handle,int mayExceed)
+{
+    resourceEntryT victim;
+    resourceEntryT *newEntries = NULL;
+    resourceEntryT *oldEntries;
+    resourceCategoryT *cat;
+    int newCapacity = 0;
+    int resource;
+    int warn = 0;
+    Sint64 warnUsage = 0,warnBudget = 0;
+
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES || size<0)
+    {
+        fprintf(stderr,"Error in resourceAdd(...): bad parameters!\n");
+        return -1;
+    }
+    cat = &categories[category];
+
+    while(1){
+        SDL_AtomicLock(&lock);
+
+        //make room first, the evict functions run without the lock so they may free whatever they like
+        if(cat->budget>0 && cat->usage+size>cat->budget && popLeastRecentlyUsed(category,&victim)){
+            SDL_AtomicUnlock(&lock);
+            victim.evict(victim.owner,victim.handle);
+            continue;
+        }
+        //checked and reserved under the same lock, so two threads can not both take the last room
+        if(!mayExceed && cat->budget>0 && cat->usage+size>cat->budget){
+            SDL_AtomicUnlock(&lock);
+            free(newEntries);
+            return -1;
+        }
+        if(firstFree>=0 || numEntries<capacity){
+            break;
+        }
+
+        //the array is full, swap in the bigger one allocated without the lock unless someone beat us to it
+        if(newEntries != NULL && newCapacity>capacity){
+            memcpy(newEntries,entries,numEntries*sizeof(resourceEntryT));
+            oldEntries = entries;
+            entries = newEntries;
+            capacity = newCapacity;
+            //freed once the lock is dropped
+            newEntries = oldEntries;
+            break;
+        }
+        newCapacity = capacity ? capacity*2 : 256;
+        SDL_AtomicUnlock(&lock);
+        free(newEntries);
+        newEntries = malloc(newCapacity*sizeof(resourceEntryT));
+        if(newEntries == NULL){
+            fprintf(stderr,"Error in resourceAdd(...): out of memory!\n");
+            return -1;
+        }
+    }
+
+    if(firstFree<0){
+        resource = numEntries++;
+    }
+    else{
+        resource = firstFree;
+        firstFree = entries[resource].nextFree;
+    }
+
+    entries[resource].category = category;
+    entries[resource].size = size;
+    entries[resource].lastUsed = ++useCounter;
+    entries[resource].evict = evict;
+    entries[resource].owner = owner;
+    entries[resource].handle = handle;
+    entries[resource].nextFree = -1;
+    cat->usage += size;
+    cat->count++;
+    if(cat->usage>cat->peak){
+        cat->peak = cat->usage;
+    }
+    if(cat->budget>0 && cat->usage>cat->budget && !cat->warnedOverBudget){
+        cat->warnedOverBudget = 1;
+        warn = 1;
+        //the category keeps changing once the lock is dropped
+        warnUsage = cat->usage;
+        warnBudget = cat->budget;
+    }
+    SDL_AtomicUnlock(&lock);
+
+    free(newEntries);
+    if(warn){
+        fprintf(stderr,"Warning: %s use %lld KB, over the budget of %lld KB with nothing left to evict\n",
+                cat->name,(long long)(warnUsage/1024),(long long)(warnBudget/1024));
+    }
+    return resource;
+}
+
+int resourceAdd(int category,Sint64 size,resourceEvictFunctionT evict,void *owner,int handle)
+{
+    return addEntry(category,size,evict,owner,handle,1);
+}
+
+int resourceTryAdd(int category,Sint64 size,resourceEvictFunctionT evict,void *owner,int handle)
+{
+    return addEntry(category,size,evict,owner,handle,0);
+}
+
+void resourceTouch(int resource)
+{
+    SDL_AtomicLock(&lock);
+    if(isValid(resource)){
+        entries[resource].lastUsed = ++useCounter;
+    }
+    SDL_AtomicUnlock(&lock);
+}
+
+void resourceRemove(int resource)
+{
+    SDL_AtomicLock(&lock);
+    if(isValid(resource)){
+        removeEntry(resource);
+    }
+    SDL_AtomicUnlock(&lock);
+}
+
+int resourceFits(int category,Sint64 size)
+{
+    int fits;
+
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES){
+        return 0;
+    }
+    SDL_AtomicLock(&lock);
+    fits = categories[category].budget<=0 || categories[category].usage+size<=categories[category].budget;
+    SDL_AtomicUnlock(&lock);
+    return fits;
+}
+
+//a copy of the category taken under the lock, a 64 bit field can be read half way through a write on 32 bit targets
+static resourceCategoryT getCategory(int category)
+{
+    resourceCategoryT copy;
+
+    SDL_AtomicLock(&lock);
+    copy = categories[category];
+    SDL_AtomicUnlock(&lock);
+    return copy;
+}
+
+Sint64 resourceGetUsage(int category)
+{
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES){
+        return 0;
+    }
+    return getCategory(category).usage;
+}
+
+Sint64 resourceGetPeak(int category)
+{
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES){
+        return 0;
+    }
+    return getCategory(category).peak;
+}
+
+Sint64 resourceGetBudget(int category)
+{
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES){
+        return 0;
+    }
+    return getCategory(category).budget;
+}
+
+int resourceGetCount(int category)
+{
+    if(category<0 || category>=RESOURCE_NUM_CATEGORIES){
+        return 0;
+    }
+    return getCategory(category).count;
+}
+
+void resourcePrintStats()
+{
+    int i;
+    Sint64 usage = 0;
+    Sint64 peak = 0;
+    resourceCategoryT cat;
+
+    fprintf(stdout,"\nmemory by category:\n");
+    for(i=0;i<RESOURCE_NUM_CATEGORIES;++i){
+        cat = getCategory(i);
+        usage += cat.usage;
+        peak += cat.peak;
+        fprintf(stdout,"  %-10s %8lld KB now, %8lld KB peak, %5d entries, %5d evicted, budget ",
+                cat.name,(long long)(cat.usage/1024),(long long)(cat.peak/1024),cat.count,cat.numEvicted);
+        if(cat.budget>0){
+            fprintf(stdout,"%lld KB\n",(long long)(cat.budget/1024));
+        }
+        else{
+            fprintf(stdout,"none\n");
+        }
+    }
+    //the categories peak at different times, so the sum of the peaks is an upper bound
+    fprintf(stdout,"  %-10s %8lld KB now, %8lld KB peak at most\n","total",(long long)(usage/1024),(long long)(peak/1024));
+}
+
+void resourceClose()
+{
+    int i;
+
+    SDL_AtomicLock(&lock);
+    free(entries);
+    entries = NULL;
+    numEntries = 0;
+    capacity = 0;
+    firstFree = -1;
+    for(i=0;i<RESOURCE_NUM_CATEGORIES;++i){
+        categories[i].usage = 0;
+        categories[i].count = 0;
+    }
+    SDL_AtomicUnlock(&lock);
+}
@@ -0,0 +1,40 @@
+#ifndef RESOURCES_H_
+#define RESOURCES_H_
+#include <SDL2/SDL.h>
+
+#define RESOURCE_TEXTURES       0
+#define RESOURCE_SURFACES       1
+#define RESOURCE_MAP_CHUNKS     2
+#define RESOURCE_SPRITE_CACHE   3
+#define RESOURCE_MAP_LOD        4
+#define RESOURCE_NUM_CATEGORIES 5
+
+//frees a resource the registry decided to evict, the registry has already forgotten about it
+typedef void (*resourceEvictFunctionT)(void *owner,int handle);
+
+/*
+ *  Registry of what the game keeps in memory, grouped by category. Every entry is a size,
+ *  and the ones that can be created again (scaled sprites and such) also have an evict
+ *  function. A category with a budget evicts its least recently touched entries to make
+ *  room before a new one is added. Entries without an evict function are only counted,
+ *  so a category can still go over its budget, which is reported once.
+ *  Pools that reserve their memory up front (the map chunk pool) are counted per block in use.
+ *  Safe to call from any thread, evict functions run on the thread that adds the entry.
+ */
+void resourceSetBudget(int category,Sint64 budgetInBytes);
+int resourceFindCategory(const char *name);
+const char *resourceCategoryName(int category);
+int resourceAdd(int category,Sint64 size,resourceEvictFunctionT evict,void *owner,int handle);
+//like resourceAdd(...) but returns -1 instead of going over the budget
+int resourceTryAdd(int category,Sint64 size,resourceEvictFunctionT evict,void *owner,int handle);
+void resourceTouch(int resource);
+void resourceRemove(int resource);
+int resourceFits(int category,Sint64 size);
+Sint64 resourceGetUsage(int category);
+Sint64 resourceGetPeak(int category);
+Sint64 resourceGetBudget(int category);
+int resourceGetCount(int category);
+void resourcePrintStats();
+void resourceClose();
+
+#endif // RESOURCES_H_
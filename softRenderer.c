@@ -0,0 +1,495 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "softRenderer.h"
+#include "resources.h"
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SOFT_USE_SSE2
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SOFT_USE_AVX2
+#endif
+
+#define SOFT_ALIGNMENT 32
+//a slot that held an evicted sprite, lookups have to probe past it
+#define SOFT_SPRITE_EVICTED -2
+
+typedef void (*blendFunctionT)(Uint32 *dst,const Uint32 *src,int count);
+
+typedef struct softImageT
+{
+    int width;
+    int height;
+    Uint32 *pixels;
+    int resource;
+}softImageT;
+
+static SDL_Renderer *renderer = NULL;
+static SDL_Texture *frameTexture = NULL;
+static Uint32 *frameMemory = NULL;
+static Uint32 *framePixels = NULL;
+static int frameWidth = 0;
+static int frameHeight = 0;
+static int frameResource = -1;
+static int frameTextureResource = -1;
+static softImageT images[SOFT_MAX_IMAGES];
+static int numImages = 0;
+static softSpriteT sprites[SOFT_SPRITE_TABLE_SIZE];
+static int numSprites = 0;
+static int numEvictedSprites = 0;
+static blendFunctionT blendSpan = NULL;
+static const char *kernelName = "none";
+
+//x*a/255 rounded, exact for every 8 bit x and a
+static Uint32 mulDiv255(Uint32 x,Uint32 a)
+{
+    Uint32 t = x*a+128;
+    return (t+(t>>8))>>8;
+}
+
+static void blendSpanScalar(Uint32 *dst,const Uint32 *src,int count)
+{
+    int i;
+    Uint32 s,d,inverse;
+
+    for(i=0;i<count;++i){
+        s = src[i];
+        d = dst[i];
+        inverse = 255-(s>>24);
+        dst[i] = s + (mulDiv255(d>>24,inverse)<<24) + (mulDiv255((d>>16)&0xff,inverse)<<16)
+                   + (mulDiv255((d>>8)&0xff,inverse)<<8) + mulDiv255(d&0xff,inverse);
+    }
+}
+
+#ifdef SOFT_USE_SSE2
+static __m128i blendPixelsSSE2(__m128i s,__m128i d)
+{
+    __m128i zero = _mm_setzero_si128();
+    __m128i full = _mm_set1_epi16(255);
+    __m128i round = _mm_set1_epi16(128);
+    __m128i sLow = _mm_unpacklo_epi8(s,zero);
+    __m128i sHigh = _mm_unpackhi_epi8(s,zero);
+    __m128i dLow = _mm_unpacklo_epi8(d,zero);
+    __m128i dHigh = _mm_unpackhi_epi8(d,zero);
+
+    //broadcast 255-alpha of every pixel over its four channels
+    sLow = _mm_sub_epi16(full,_mm_shufflehi_epi16(_mm_shufflelo_epi16(sLow,0xff),0xff));
+    sHigh = _mm_sub_epi16(full,_mm_shufflehi_epi16(_mm_shufflelo_epi16(sHigh,0xff),0xff));
+    dLow = _mm_add_epi16(_mm_mullo_epi16(dLow,sLow),round);
+    dHigh = _mm_add_epi16(_mm_mullo_epi16(dHigh,sHigh),round);
+    dLow = _mm_srli_epi16(_mm_add_epi16(dLow,_mm_srli_epi16(dLow,8)),8);
+    dHigh = _mm_srli_epi16(_mm_add_epi16(dHigh,_mm_srli_epi16(dHigh,8)),8);
+    return _mm_add_epi8(s,_mm_packus_epi16(dLow,dHigh));
+}
+
+static void blendSpanSSE2(Uint32 *dst,const Uint32 *src,int count)
+{
+    int i = 0;
+
+    for(;i+4<=count;i+=4){
+        _mm_storeu_si128((__m128i*)&dst[i],blendPixelsSSE2(_mm_loadu_si128((const __m128i*)&src[i]),
+                                                          _mm_loadu_si128((const __m128i*)&dst[i])));
+    }
+    blendSpanScalar(&dst[i],&src[i],count-i);
+}
+#endif
+
+#ifdef SOFT_USE_AVX2
+__attribute__((target("avx2")))
+static void blendSpanAVX2(Uint32 *dst,const Uint32 *src,int count)
+{
+    int i = 0;
+    __m256i zero = _mm256_setzero_si256();
+    __m256i full = _mm256_set1_epi16(255);
+    __m256i round = _mm256_set1_epi16(128);
+    __m256i s,sLow,sHigh,dLow,dHigh;
+
+    //same as the SSE2 kernel, the unpacks and the pack all work within 128 bit lanes so the order survives
+    for(;i+8<=count;i+=8){
+        s = _mm256_loadu_si256((const __m256i*)&src[i]);
+        dLow = _mm256_loadu_si256((const __m256i*)&dst[i]);
+        dHigh = _mm256_unpackhi_epi8(dLow,zero);
+        dLow = _mm256_unpacklo_epi8(dLow,zero);
+        sLow = _mm256_unpacklo_epi8(s,zero);
+        sHigh = _mm256_unpackhi_epi8(s,zero);
+        sLow = _mm256_sub_epi16(full,_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sLow,0xff),0xff));
+        sHigh = _mm256_sub_epi16(full,_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sHigh,0xff),0xff));
+        dLow = _mm256_add_epi16(_mm256_mullo_epi16(dLow,sLow),round);
+        dHigh = _mm256_add_epi16(_mm256_mullo_epi16(dHigh,sHigh),round);
+        dLow = _mm256_srli_epi16(_mm256_add_epi16(dLow,_mm256_srli_epi16(dLow,8)),8);
+        dHigh = _mm256_srli_epi16(_mm256_add_epi16(dHigh,_mm256_srli_epi16(dHigh,8)),8);
+        _mm256_storeu_si256((__m256i*)&dst[i],_mm256_add_epi8(s,_mm256_packus_epi16(dLow,dHigh)));
+    }
+    blendSpanScalar(&dst[i],&src[i],count-i);
+}
+#endif
+
+static void selectKernel(int kernel)
+{
+    blendSpan = blendSpanScalar;
+    kernelName = "scalar";
+#ifdef SOFT_USE_SSE2
+    if((kernel == SOFT_KERNEL_AUTO || kernel == SOFT_KERNEL_SSE2) && SDL_HasSSE2()){
+        blendSpan = blendSpanSSE2;
+        kernelName = "SSE2";
+    }
+#endif
+#ifdef SOFT_USE_AVX2
+    if((kernel == SOFT_KERNEL_AUTO || kernel == SOFT_KERNEL_AVX2) && SDL_HasAVX2()){
+        blendSpan = blendSpanAVX2;
+        kernelName = "AVX2";
+    }
+#endif
+}
+
+int softRendererInit(SDL_Renderer *newRenderer,int width,int height,int kernel)
+{
+    if(width<=0 || height<=0)
+    {
+        fprintf(stderr,"Error in softRendererInit(...): bad parameters!\n");
+        return 0;
+    }
+    softRendererClose();
+
+    frameMemory = malloc((size_t)width*height*sizeof(Uint32)+SOFT_ALIGNMENT);
+    if(frameMemory == NULL){
+        fprintf(stderr,"Error in softRendererInit(...): could not allocate the frame buffer!\n");
+        return 0;
+    }
+    framePixels = (Uint32*)(((size_t)frameMemory+SOFT_ALIGNMENT-1) & ~(size_t)(SOFT_ALIGNMENT-1));
+    frameWidth = width;
+    frameHeight = height;
+    frameResource = resourceAdd(RESOURCE_SURFACES,(Sint64)width*height*sizeof(Uint32),NULL,NULL,0);
+
+    //without a renderer the frame only lives in memory, which is what the benchmarks use
+    renderer = newRenderer;
+    if(renderer != NULL){
+        frameTexture = SDL_CreateTexture(renderer,SDL_PIXELFORMAT_ARGB8888,SDL_TEXTUREACCESS_STREAMING,width,height);
+        if(frameTexture == NULL){
+            fprintf(stderr,"Error in softRendererInit(...): could not create the frame texture! SDL Error:%s\n",SDL_GetError());
+            softRendererClose();
+            return 0;
+        }
+        SDL_SetTextureBlendMode(frameTexture,SDL_BLENDMODE_NONE);
+        frameTextureResource = resourceAdd(RESOURCE_TEXTURES,(Sint64)width*height*sizeof(Uint32),NULL,NULL,0);
+    }
+    selectKernel(kernel);
+    return 1;
+}
+
+int softRendererIsActive()
+{
+    return framePixels != NULL;
+}
+
+const char *softRendererKernelName()
+{
+    return kernelName;
+}
+
+int softRendererAddImage(Uint32 *pixels,int width,int height,int pitch)
+{
+    softImageT *image;
+    Uint32 pixel,alpha;
+    int x,y;
+
+    if(numImages>=SOFT_MAX_IMAGES){
+        fprintf(stderr,"Error in softRendererAddImage(...): no more than %d images!\n",SOFT_MAX_IMAGES);
+        return -1;
+    }
+    image = &images[numImages];
+    image->pixels = malloc((size_t)width*height*sizeof(Uint32));
+    if(image->pixels == NULL){
+        fprintf(stderr,"Error in softRendererAddImage(...): out of memory!\n");
+        return -1;
+    }
+    image->width = width;
+    image->height = height;
+    image->resource = resourceAdd(RESOURCE_SURFACES,(Sint64)width*height*sizeof(Uint32),NULL,NULL,0);
+
+    //premultiply once here so blending is a single multiply per channel
+    for(y=0;y<height;++y){
+        for(x=0;x<width;++x){
+            pixel = ((Uint32*)((Uint8*)pixels+y*pitch))[x];
+            alpha = pixel>>24;
+            image->pixels[y*width+x] = (alpha<<24) + (mulDiv255((pixel>>16)&0xff,alpha)<<16)
+                                     + (mulDiv255((pixel>>8)&0xff,alpha)<<8) + mulDiv255(pixel&0xff,alpha);
+        }
+    }
+    return numImages++;
+}
+
+static void freeSprites()
+{
+    int i;
+    for(i=0;i<SOFT_SPRITE_TABLE_SIZE;++i){
+        if(sprites[i].pixels != NULL){
+            resourceRemove(sprites[i].resource);
+        }
+        free(sprites[i].pixels);
+        free(sprites[i].spans);
+    }
+    memset(sprites,0,sizeof(sprites));
+    numSprites = 0;
+    numEvictedSprites = 0;
+}
+
+//called by the resource registry when the sprite cache is over its budget, the sprite is scaled again when it is needed
+static void evictSprite(void *owner,int handle)
+{
+    softSpriteT *sprite = &sprites[handle];
+
+    free(sprite->pixels);
+    free(sprite->spans);
+    memset(sprite,0,sizeof(softSpriteT));
+    sprite->image = SOFT_SPRITE_EVICTED;
+    numSprites--;
+    numEvictedSprites++;
+}
+
+static void buildSprite(softSpriteT *sprite,softImageT *image)
+{
+    int x,y;
+    int srcX,srcY;
+    int start,end;
+    Uint32 *row;
+    Sint16 *span;
+
+    //nearest neighbour, sampling the middle of every destination pixel like the SDL renderers
+    for(y=0;y<sprite->height;++y){
+        row = &sprite->pixels[y*sprite->width];
+        srcY = sprite->clip.y+((2*y+1)*sprite->clip.h)/(2*sprite->height);
+        for(x=0;x<sprite->width;++x){
+            srcX = sprite->clip.x+((2*x+1)*sprite->clip.w)/(2*sprite->width);
+            row[x] = 0;
+            if(srcX>=0 && srcY>=0 && srcX<image->width && srcY<image->height){
+                row[x] = image->pixels[srcY*image->width+srcX];
+            }
+        }
+
+        span = &sprite->spans[y*4];
+        for(start=0;start<sprite->width && (row[start]>>24)==0;++start);
+        for(end=sprite->width;end>start && (row[end-1]>>24)==0;--end);
+        span[0] = start;
+        span[3] = end;
+        for(;start<end && (row[start]>>24)!=0xff;++start);
+        span[1] = start;
+        for(;start<end && (row[start]>>24)==0xff;++start);
+        span[2] = start;
+    }
+}
+
+static softSpriteT *getSprite(int image,SDL_Rect *clip,int width,int height)
+{
+    softSpriteT *sprite;
+    Uint32 hash;
+    SDL_Rect fullClip;
+    Uint32 *pixels;
+    Sint16 *spans;
+    int freeSlot = -1;
+
+    if(image<0 || image>=numImages || width<=0 || height<=0){
+        return NULL;
+    }
+    if(clip == NULL){
+        fullClip.x = 0;
+        fullClip.y = 0;
+        fullClip.w = images[image].width;
+        fullClip.h = images[image].height;
+        clip = &fullClip;
+    }
+
+    hash = (Uint32)image*73856093u ^ (Uint32)clip->x*19349663u ^ (Uint32)clip->y*83492791u
+         ^ (Uint32)clip->w*2654435761u ^ (Uint32)width*40503u ^ (Uint32)height*2246822519u;
+    hash &= SOFT_SPRITE_TABLE_SIZE-1;
+    while(sprites[hash].pixels != NULL || sprites[hash].image == SOFT_SPRITE_EVICTED){
+        sprite = &sprites[hash];
+        if(sprite->pixels == NULL){
+            if(freeSlot<0){
+                freeSlot = hash;
+            }
+        }
+        else if(sprite->image == image && sprite->width == width && sprite->height == height &&
+           sprite->clip.x == clip->x && sprite->clip.y == clip->y && sprite->clip.w == clip->w && sprite->clip.h == clip->h){
+            return sprite;
+        }
+        hash = (hash+1)&(SOFT_SPRITE_TABLE_SIZE-1);
+    }
+
+    //every zoom level adds a new set of sprites, start over when the table fills up
+    if(numSprites+numEvictedSprites>=SOFT_SPRITE_TABLE_SIZE/2){
+        freeSprites();
+        return getSprite(image,clip,width,height);
+    }
+
+    //the slot is only taken once both allocations worked, a failure leaves the tombstone or the empty slot as it was
+    pixels = malloc((size_t)width*height*sizeof(Uint32));
+    spans = malloc((size_t)height*4*sizeof(Sint16));
+    if(pixels == NULL || spans == NULL){
+        free(pixels);
+        free(spans);
+        return NULL;
+    }
+    if(freeSlot>=0){
+        hash = freeSlot;
+        numEvictedSprites--;
+    }
+
+    sprite = &sprites[hash];
+    sprite->pixels = pixels;
+    sprite->spans = spans;
+    sprite->image = image;
+    sprite->clip = *clip;
+    sprite->width = width;
+    sprite->height = height;
+    buildSprite(sprite,&images[image]);
+    numSprites++;
+    //may evict other sprites to stay in the budget, never this one
+    sprite->resource = resourceAdd(RESOURCE_SPRITE_CACHE,(Sint64)width*height*sizeof(Uint32)+height*4*sizeof(Sint16),
+                                   evictSprite,NULL,hash);
+    return sprite;
+}
+
+void softRendererClear(Uint8 r,Uint8 g,Uint8 b)
+{
+    int i;
+    Uint32 color = 0xff000000u | ((Uint32)r<<16) | ((Uint32)g<<8) | b;
+
+    for(i=0;i<frameWidth*frameHeight;++i){
+        framePixels[i] = color;
+    }
+}
+
+void softRendererBlit(int image,SDL_Rect *clip,SDL_Rect *quad)
+{
+    softSpriteT *sprite;
+    Uint32 *dst;
+    Uint32 *src;
+    Sint16 *span;
+    int y,minX,maxX,minY,maxY;
+    int blendStart,copyStart,copyEnd,blendEnd;
+
+    if(framePixels == NULL){
+        return;
+    }
+    sprite = getSprite(image,clip,quad->w,quad->h);
+    if(sprite == NULL){
+        return;
+    }
+    resourceTouch(sprite->resource);
+
+    //the part of the sprite that is on the screen, in sprite coordinates
+    minX = quad->x<0 ? -quad->x : 0;
+    minY = quad->y<0 ? -quad->y : 0;
+    maxX = quad->x+sprite->width>frameWidth ? frameWidth-quad->x : sprite->width;
+    maxY = quad->y+sprite->height>frameHeight ? frameHeight-quad->y : sprite->height;
+
+    for(y=minY;y<maxY;++y){
+        span = &sprite->spans[y*4];
+        blendStart = SDL_max(span[0],minX);
+        copyStart = SDL_max(SDL_min(span[1],maxX),blendStart);
+        copyEnd = SDL_max(SDL_min(span[2],maxX),copyStart);
+        blendEnd = SDL_max(SDL_min(span[3],maxX),copyEnd);
+
+        src = &sprite->pixels[y*sprite->width];
+        dst = &framePixels[(quad->y+y)*frameWidth];
+        if(copyStart>blendStart){
+            blendSpan(&dst[quad->x+blendStart],&src[blendStart],copyStart-blendStart);
+        }
+        if(copyEnd>copyStart){
+            memcpy(&dst[quad->x+copyStart],&src[copyStart],(copyEnd-copyStart)*sizeof(Uint32));
+        }
+        if(blendEnd>copyEnd){
+            blendSpan(&dst[quad->x+copyEnd],&src[copyEnd],blendEnd-copyEnd);
+        }
+    }
+}
+
+//for small tinted quads like particles, these are not worth caching
+void softRendererBlitModulate(int image,SDL_Rect *clip,SDL_Rect *quad,SDL_Color color)
+{
+    softImageT *source;
+    Uint32 pixel;
+    int x,y,srcX,srcY;
+    int minX,minY,maxX,maxY;
+    Uint32 r,g,b,a;
+
+    if(framePixels == NULL || image<0 || image>=numImages || clip == NULL || quad->w<=0 || quad->h<=0){
+        return;
+    }
+    source = &images[image];
+
+    //color is applied first and then the alpha, the source is already premultiplied
+    r = mulDiv255(color.r,color.a);
+    g = mulDiv255(color.g,color.a);
+    b = mulDiv255(color.b,color.a);
+    a = color.a;
+
+    minX = SDL_max(quad->x,0);
+    minY = SDL_max(quad->y,0);
+    maxX = SDL_min(quad->x+quad->w,frameWidth);
+    maxY = SDL_min(quad->y+quad->h,frameHeight);
+    for(y=minY;y<maxY;++y){
+        srcY = clip->y+((2*(y-quad->y)+1)*clip->h)/(2*quad->h);
+        if(srcY<0 || srcY>=source->height){
+            continue;
+        }
+        for(x=minX;x<maxX;++x){
+            srcX = clip->x+((2*(x-quad->x)+1)*clip->w)/(2*quad->w);
+            if(srcX<0 || srcX>=source->width){
+                continue;
+            }
+            pixel = source->pixels[srcY*source->width+srcX];
+            pixel = (mulDiv255(pixel>>24,a)<<24) + (mulDiv255((pixel>>16)&0xff,r)<<16)
+                  + (mulDiv255((pixel>>8)&0xff,g)<<8) + mulDiv255(pixel&0xff,b);
+            blendSpanScalar(&framePixels[y*frameWidth+x],&pixel,1);
+        }
+    }
+}
+
+Uint32 *softRendererGetPixels()
+{
+    return framePixels;
+}
+
+void softRendererPresent()
+{
+    if(framePixels == NULL || frameTexture == NULL){
+        return;
+    }
+    //one upload and one copy for the whole frame
+    SDL_UpdateTexture(frameTexture,NULL,framePixels,frameWidth*sizeof(Uint32));
+    SDL_RenderCopy(renderer,frameTexture,NULL,NULL);
+}
+
+void softRendererClose()
+{
+    int i;
+
+    freeSprites();
+    for(i=0;i<numImages;++i){
+        resourceRemove(images[i].resource);
+        free(images[i].pixels);
+    }
+    memset(images,0,sizeof(images));
+    numImages = 0;
+    if(frameTexture != NULL){
+        resourceRemove(frameTextureResource);
+        frameTextureResource = -1;
+        SDL_DestroyTexture(frameTexture);
+        frameTexture = NULL;
+    }
+    if(frameMemory != NULL){
+        resourceRemove(frameResource);
+        frameResource = -1;
+    }
+    free(frameMemory);
+    frameMemory = NULL;
+    framePixels = NULL;
+    frameWidth = 0;
+    frameHeight = 0;
+    renderer = NULL;
+}
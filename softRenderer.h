@@ -0,0 +1,43 @@
+#ifndef SOFTRENDERER_H_
+#define SOFTRENDERER_H_
+#include <SDL2/SDL.h>
+
+#define SOFT_MAX_IMAGES         8
+#define SOFT_SPRITE_TABLE_SIZE  512
+
+#define SOFT_KERNEL_AUTO        0
+#define SOFT_KERNEL_SCALAR      1
+#define SOFT_KERNEL_SSE2        2
+#define SOFT_KERNEL_AVX2        3
+
+/*
+ *  Software render backend. Images are kept in RAM as premultiplied ARGB and every
+ *  clip is scaled once per zoom level into a sprite. A sprite row is split into a
+ *  blended edge, an opaque run that is copied straight over and another blended edge,
+ *  which is the shape of every isometric tile. The frame is composited into one
+ *  buffer and uploaded to a streaming texture once per frame.
+ */
+typedef struct softSpriteT
+{
+    int image;
+    SDL_Rect clip;
+    int width;
+    int height;
+    Uint32 *pixels;
+    //visible start, opaque start, opaque end and visible end for every row
+    Sint16 *spans;
+    int resource;
+}softSpriteT;
+
+int softRendererInit(SDL_Renderer *renderer,int width,int height,int kernel);
+int softRendererIsActive();
+const char *softRendererKernelName();
+int softRendererAddImage(Uint32 *pixels,int width,int height,int pitch);
+void softRendererClear(Uint8 r,Uint8 g,Uint8 b);
+void softRendererBlit(int image,SDL_Rect *clip,SDL_Rect *quad);
+void softRendererBlitModulate(int image,SDL_Rect *clip,SDL_Rect *quad,SDL_Color color);
+Uint32 *softRendererGetPixels();
+void softRendererPresent();
+void softRendererClose();
+
+#endif // SOFTRENDERER_H_
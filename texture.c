@@ -5,33 +5,75 @@
 #include "isoEngine.h"
 #include "renderer.h"
 #include "texture.h"
+#include "softRenderer.h"
+#include "resources.h"
+
+//the software renderer keeps its own copy of the pixels in RAM
+static int loadSoftImage(textureT *texture, SDL_Surface *surface)
+{
+    SDL_Surface *converted = SDL_ConvertSurfaceFormat(surface,SDL_PIXELFORMAT_ARGB8888,0);
+
+    if(converted == NULL){
+        return 0;
+    }
+    SDL_LockSurface(converted);
+    texture->softImage = softRendererAddImage(converted->pixels,converted->w,converted->h,converted->pitch);
+    SDL_UnlockSurface(converted);
+    SDL_FreeSurface(converted);
+    return texture->softImage>=0;
+}
 
 int loadTexture(textureT *texture, char *filename)
 {
     SDL_Surface *tmpSurface = IMG_Load(filename);
+    int surfaceResource;
 
     if(tmpSurface == NULL){
         fprintf(stderr,"Texture error: Could not load image:%s! SDL_image Error:%s\n",filename,IMG_GetError());
         return 0;
     }
     else{
+        //the decoded image only lives until the texture is made, but it counts towards the peak
+        surfaceResource = resourceAdd(RESOURCE_SURFACES,(Sint64)tmpSurface->h*tmpSurface->pitch,NULL,NULL,0);
         texture->texture = SDL_CreateTextureFromSurface(getRenderer(),tmpSurface);
 
         if(texture->texture == NULL){
             fprintf(stderr,"Texture error: Could not load image:%s! SDL_image Error:%s\n",filename,IMG_GetError());
+            resourceRemove(surfaceResource);
             SDL_FreeSurface(tmpSurface);
             return 0;
         }
         else{
             texture->width = tmpSurface->w;
             texture->height = tmpSurface->h;
+            texture->resource = resourceAdd(RESOURCE_TEXTURES,(Sint64)tmpSurface->w*tmpSurface->h*4,NULL,NULL,0);
         }
+        if(softRendererIsActive() && loadSoftImage(texture,tmpSurface)==0){
+            fprintf(stderr,"Texture error: Could not copy image:%s for the software renderer!\n",filename);
+            textureFree(texture);
+            resourceRemove(surfaceResource);
+            SDL_FreeSurface(tmpSurface);
+            return 0;
+        }
+        resourceRemove(surfaceResource);
         SDL_FreeSurface(tmpSurface);
         return 1;
     }
     return 0;
 }
 
+//the decoded surface is already gone when loadTexture(...) returns, this only releases the texture
+void textureFree(textureT *texture)
+{
+    if(texture == NULL || texture->texture == NULL){
+        return;
+    }
+    resourceRemove(texture->resource);
+    SDL_DestroyTexture(texture->texture);
+    texture->texture = NULL;
+    texture->resource = -1;
+}
+
 void textureInit(textureT *texture, int x,int y, double angle, SDL_Point *center, SDL_Rect *cliprect, SDL_RendererFlip fliptype)
 {
     texture->x = x;
@@ -40,6 +82,8 @@ void textureInit(textureT *texture, int x,int y, double angle, SDL_Point *center
     texture->center = center;
     texture->fliptype = fliptype;
     texture->cliprect = cliprect;
+    texture->softImage = -1;
+    texture->resource = -1;
 }
 
 void textureRenderXYClip(textureT *texture, int x, int y, SDL_Rect *cliprect)
@@ -58,31 +102,74 @@ void textureRenderXYClip(textureT *texture, int x, int y, SDL_Rect *cliprect)
         quad.h = texture->cliprect->h;
     }
 
+    if(texture->softImage>=0){
+        softRendererBlit(texture->softImage,texture->cliprect,&quad);
+        return;
+    }
     SDL_RenderCopyEx(getRenderer(),texture->texture,texture->cliprect,&quad,texture->angle, texture->center,texture->fliptype);
 }
-void textureRenderXYClipScale(textureT *texture, int x, int y, SDL_Rect *cliprect,float scale)
+//the screen rectangle textureRenderXYClipScale(...) draws a clipped sprite into
+void textureClipScaleQuad(int x, int y, SDL_Rect *cliprect, float scale, SDL_Rect *quad)
 {
-    float w,h;
     float diffx,diffy;
-    SDL_Rect quad;
-    w=(float)texture->width+1*scale;
-    h=(float)texture->height+1*scale;
 
     diffx = (x*scale) - x;
     diffy = (y*scale) - y;
 
-    setupRect(&quad,(x*scale)-diffx,(y*scale)-diffy,w,h);
+    setupRect(quad,(x*scale)-diffx,(y*scale)-diffy,(int)cliprect->w*scale,(int)cliprect->h*scale);
+
+    if(scale <1.0 || scale >1.0){
+        quad->h +=1;
+        quad->w +=1;
+    }
+}
+
+void textureRenderXYClipScale(textureT *texture, int x, int y, SDL_Rect *cliprect,float scale)
+{
+    float w,h;
+    float diffx,diffy;
+    SDL_Rect quad;
 
     texture->cliprect = cliprect;
 
     if(texture->cliprect != NULL){
-        quad.w = (int)texture->cliprect->w*scale;
-        quad.h = (int)texture->cliprect->h*scale;
+        textureClipScaleQuad(x,y,texture->cliprect,scale,&quad);
+    }
+    else{
+        w=(float)texture->width+1*scale;
+        h=(float)texture->height+1*scale;
 
-        if(scale <1.0 || scale >1.0){
-            quad.h +=1;
-            quad.w +=1;
-        }
+        diffx = (x*scale) - x;
+        diffy = (y*scale) - y;
+
+        setupRect(&quad,(x*scale)-diffx,(y*scale)-diffy,w,h);
+    }
+    if(texture->softImage>=0){
+        softRendererBlit(texture->softImage,texture->cliprect,&quad);
+        return;
     }
     SDL_RenderCopyEx(getRenderer(),texture->texture,texture->cliprect,&quad,texture->angle,texture->center,texture->fliptype);
 }
+
+//vertices come in groups of 4 (top left, top right, bottom right, bottom left) with 6 indices per quad
+void textureRenderQuadBatch(textureT *texture, SDL_Vertex *vertices, int *indices, int numQuads)
+{
+    int i;
+    SDL_Rect src,quad;
+    SDL_Vertex *v;
+
+    if(texture==NULL || numQuads<=0){
+        return;
+    }
+    if(texture->softImage>=0){
+        for(i=0;i<numQuads;++i){
+            v = &vertices[i*4];
+            setupRect(&src,v[0].tex_coord.x*texture->width,v[0].tex_coord.y*texture->height,
+                      (v[2].tex_coord.x-v[0].tex_coord.x)*texture->width,(v[2].tex_coord.y-v[0].tex_coord.y)*texture->height);
+            setupRect(&quad,v[0].position.x,v[0].position.y,v[2].position.x-v[0].position.x,v[2].position.y-v[0].position.y);
+            softRendererBlitModulate(texture->softImage,&src,&quad,v[0].color);
+        }
+        return;
+    }
+    SDL_RenderGeometry(getRenderer(),texture->texture,vertices,numQuads*4,indices,numQuads*6);
+}
@@ -1,5 +1,11 @@
 #ifndef TEXTURE_H_
 #define TEXTURE_H_
+#include <SDL2/SDL.h>
+
+//the particles are drawn as one batch of SDL_Vertex quads through SDL_RenderGeometry(...)
+#if !SDL_VERSION_ATLEAST(2,0,18)
+#error "SDL 2.0.18 or newer is needed for SDL_RenderGeometry"
+#endif
 
 typedef struct textureT
 {
@@ -12,11 +18,16 @@ typedef struct textureT
     SDL_Rect *cliprect;
     SDL_RendererFlip fliptype;
     SDL_Texture *texture;
+    int softImage;
+    int resource;
 }textureT;
 
 int loadTexture(textureT *texture, char *filename);
 void textureInit(textureT *texture, int x,int y, double angle, SDL_Point *center, SDL_Rect *cliprect, SDL_RendererFlip fliptype);
+void textureFree(textureT *texture);
 void textureRenderXYClip(textureT *texture, int x, int y, SDL_Rect *cliprect);
 void textureRenderXYClipScale(textureT *texture, int x, int y, SDL_Rect *cliprect,float scale);
+void textureClipScaleQuad(int x, int y, SDL_Rect *cliprect, float scale, SDL_Rect *quad);
+void textureRenderQuadBatch(textureT *texture, SDL_Vertex *vertices, int *indices, int numQuads);
 
 #endif // TEXTURE_H_
@@ -0,0 +1,53 @@
+#ifndef TILELAYOUT_H_
+#define TILELAYOUT_H_
+#include <SDL2/SDL.h>
+
+/*
+ *  Z-order (Morton) layout helpers.
+ *
+ *  Interleaving the bits of x and y keeps tiles that are close in both directions
+ *  close in memory, so the diagonal walk of the isometric renderer touches a few
+ *  cache lines per block instead of one cache line per tile.
+ *  Coordinates are limited to 16 bits each.
+ */
+
+static inline Uint32 mortonSpreadBits(Uint32 value)
+{
+    value &= 0x0000ffff;
+    value = (value | (value<<8)) & 0x00ff00ff;
+    value = (value | (value<<4)) & 0x0f0f0f0f;
+    value = (value | (value<<2)) & 0x33333333;
+    value = (value | (value<<1)) & 0x55555555;
+    return value;
+}
+
+static inline Uint32 mortonCompactBits(Uint32 value)
+{
+    value &= 0x55555555;
+    value = (value | (value>>1)) & 0x33333333;
+    value = (value | (value>>2)) & 0x0f0f0f0f;
+    value = (value | (value>>4)) & 0x00ff00ff;
+    value = (value | (value>>8)) & 0x0000ffff;
+    return value;
+}
+
+static inline Uint32 mortonEncode2D(Uint32 x,Uint32 y)
+{
+    return mortonSpreadBits(x) | (mortonSpreadBits(y)<<1);
+}
+
+static inline void mortonDecode2D(Uint32 index,Uint32 *x,Uint32 *y)
+{
+    *x = mortonCompactBits(index);
+    *y = mortonCompactBits(index>>1);
+}
+
+//tiled layout: blocks of (1<<blockShift)^2 tiles stored row by row, Morton order inside a block
+static inline Uint32 tiledIndex2D(Uint32 x,Uint32 y,int blockShift,Uint32 blocksWide)
+{
+    Uint32 blockMask = (1u<<blockShift)-1;
+    Uint32 block = (y>>blockShift)*blocksWide + (x>>blockShift);
+    return (block<<(2*blockShift)) | mortonEncode2D(x&blockMask,y&blockMask);
+}
+
+#endif // TILELAYOUT_H_
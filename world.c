@@ -0,0 +1,419 @@
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "world.h"
+
+#define WORLD_TILE_SIZE     32
+#define WORLD_ZOOM_STEP     0.25
+//small enough to fit the whole map on the screen
+#define WORLD_MIN_ZOOM      (1.0/512)
+#define WORLD_MAX_ZOOM      3.0
+
+//what goes into a save next to the map, keep it under MAP_SAVE_MAX_EXTRA bytes
+typedef struct worldSaveStateT
+{
+    point2DT charPoint;
+    int charDirection;
+    point2DT mapScroll2Dpos;
+    float zoomLevel;
+    int gameMode;
+}worldSaveStateT;
+
+static Uint32 hashMapBlock(int x,int y)
+{
+    Uint32 hash = (Uint32)x*73856093u ^ (Uint32)y*19349663u;
+    hash ^= hash>>13;
+    hash *= 0x5bd1e995u;
+    hash ^= hash>>15;
+    return hash;
+}
+
+//called from the map stream I/O thread (or from job threads for headless worlds), so the map is
+//built from the block coordinates instead of rand() to give the same chunk every time it is reloaded
+static void generateMapChunk(int chunkX,int chunkY,Uint8 *tiles)
+{
+    int x,y;
+    int mapX,mapY;
+    int tile;
+    int paintTile=0;
+    for(y=0;y<MAP_CHUNK_SIZE;y+=2)
+    {
+        for(x=0;x<MAP_CHUNK_SIZE;x+=2)
+        {
+            mapX = chunkX*MAP_CHUNK_SIZE+x;
+            mapY = chunkY*MAP_CHUNK_SIZE+y;
+            tile = 1;
+            paintTile = hashMapBlock(mapX,mapY)%10;
+
+            if(paintTile>8)
+            {
+                if(mapY<MAP_HEIGHT-4 && mapX<MAP_WIDTH-4){
+                    tile = 4;
+                }
+            }
+            if(paintTile==7){
+                if(mapY<MAP_HEIGHT-4 && mapX<MAP_WIDTH-4){
+                    tile = 3;
+                }
+            }
+            tiles[MAP_CHUNK_TILE_INDEX(x,y)] = tile;
+            tiles[MAP_CHUNK_TILE_INDEX(x,y+1)] = tile;
+            tiles[MAP_CHUNK_TILE_INDEX(x+1,y)] = tile;
+            tiles[MAP_CHUNK_TILE_INDEX(x+1,y+1)] = tile;
+        }
+    }
+}
+
+int worldInit(worldT *world,int viewWidth,int viewHeight,int memoryBudgetInBytes,const char *directory)
+{
+    if(world == NULL)
+    {
+        fprintf(stderr,"Error in worldInit(...): world parameter is NULL!\n");
+        return 0;
+    }
+    if(InitIsoEngine(&world->isoEngine,WORLD_TILE_SIZE)==0){
+        return 0;
+    }
+    IsoEngineSetMapSize(&world->isoEngine,16,16);
+
+    //a NULL directory keeps the whole map in memory, no files and no I/O thread
+    if(mapStreamInit(&world->mapStream,MAP_WIDTH,MAP_HEIGHT,memoryBudgetInBytes,directory,generateMapChunk)==0){
+        fprintf(stderr,"Error in worldInit(...): could not start the map stream\n");
+        return 0;
+    }
+    world->isoEngine.scrollX = 0;
+    world->isoEngine.scrollY = 0;
+    world->mapScroll2Dpos.x = 0;
+    world->mapScroll2Dpos.y = 0;
+    world->mapScrolllSpeed = 6;
+    world->zoomLevel = 1.0;
+    world->viewWidth = viewWidth;
+    world->viewHeight = viewHeight;
+    world->tilePos.x = 0;
+    world->tilePos.y = 0;
+    world->charPoint.x = 0;
+    world->charPoint.y = 0;
+    world->charDirection = PLAYER_DIR_DOWN;
+    world->gameMode = GAME_MODE_OVERVIEW;
+    world->numTicks = 0;
+    return 1;
+}
+
+void worldStep(worldT *world,worldInputT *input)
+{
+    worldUpdateCamera(world,input);
+    worldUpdateMapStream(world);
+    worldMoveCharacter(world,input);
+    world->numTicks++;
+}
+
+static void scrollMapWithMouse(worldT *world,worldInputT *input)
+{
+    int zoomEdgeX = (world->viewWidth*world->zoomLevel)-(world->viewWidth);
+    int zoomEdgeY = (world->viewHeight*world->zoomLevel)-(world->viewHeight);
+
+    if(input->mouseX<2){
+        world->mapScroll2Dpos.x-=world->mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&world->isoEngine,&world->mapScroll2Dpos);
+    }
+    if(input->mouseX>world->viewWidth-(zoomEdgeX/world->zoomLevel)-2){
+        world->mapScroll2Dpos.x+=world->mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&world->isoEngine,&world->mapScroll2Dpos);
+
+    }
+    if(input->mouseY<2){
+        world->mapScroll2Dpos.y+=world->mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&world->isoEngine,&world->mapScroll2Dpos);
+
+    }
+    if(input->mouseY>world->viewHeight-(zoomEdgeY/world->zoomLevel)-2){
+        world->mapScroll2Dpos.y-=world->mapScrolllSpeed;
+        convertCartesianCameraToIsometric(&world->isoEngine,&world->mapScroll2Dpos);
+
+    }
+
+}
+
+void worldUpdateCamera(worldT *world,worldInputT *input)
+{
+    if(world->gameMode == GAME_MODE_OBJECT_FOCUS)
+    {
+        worldCenterMap(world,&world->charPoint);
+    }
+    else if(world->gameMode == GAME_MODE_OVERVIEW && input->hasMouse){
+        scrollMapWithMouse(world,input);
+    }
+}
+
+void worldGetViewRange(worldT *world,int *startX,int *startY,int *endX,int *endY)
+{
+    //whole pixels are enough for whole tiles, so the divides by the tile size are ISO_TILE_DIV(...)
+    int scrollX = world->mapScroll2Dpos.x/world->zoomLevel;
+    int scrollY = world->mapScroll2Dpos.y/world->zoomLevel;
+    int numTilesInWidth = ISO_TILE_DIV(world->viewWidth)/world->zoomLevel;
+    int numTilesInHeight = (ISO_TILE_DIV(world->viewHeight)/world->zoomLevel)*2;
+
+    *startX = -3/world->zoomLevel + ISO_TILE_DIV(scrollX*2);
+    *startY = -20/world->zoomLevel + ISO_TILE_DIV(abs(scrollY))*2;
+    *endX = *startX+numTilesInWidth+5;
+    *endY = *startY+numTilesInHeight+26;
+}
+
+void worldUpdateMapStream(worldT *world)
+{
+    int startX,startY,endX,endY;
+
+    //zoomed out the map is drawn from the LOD pyramid, streaming in everything on screen would not fit the budget,
+    //but the requests already on their way (and a save) still have to be finished
+    if(world->zoomLevel<1.0){
+        mapStreamPoll(&world->mapStream);
+        return;
+    }
+    worldGetViewRange(world,&startX,&startY,&endX,&endY);
+
+    //the screen rows and columns of drawIsoMap map to diagonals in the map,
+    //so the tiles it can reach are bounded by the sums and differences of the corners
+    mapStreamUpdate(&world->mapStream,(startY+startX)/2,(startY-endX)/2,(endY+endX)/2,(endY-startX)/2);
+}
+
+void worldMoveCharacter(worldT *world,worldInputT *input)
+{
+    int up = input->moveUp;
+    int down = input->moveDown;
+    int left = input->moveLeft;
+    int right = input->moveRight;
+
+    if(down && !right && !left && !up)
+    {
+        world->charPoint.x+=5;
+        world->charPoint.y+=5;
+        world->charDirection = PLAYER_DIR_DOWN;
+    }
+    else if(!down && !right && !left && up)
+    {
+        world->charPoint.x-=5;
+        world->charPoint.y-=5;
+        world->charDirection = PLAYER_DIR_UP;
+    }
+    else if(!down && right && !left && up)
+    {
+        world->charPoint.y-=5;
+        world->charDirection = PLAYER_DIR_UP_RIGHT;
+    }
+    else if(!down && !right && left && up)
+    {
+        world->charPoint.x-=5;
+        world->charDirection = PLAYER_DIR_UP_LEFT;
+    }
+    else if(!down && right && !left && !up)
+    {
+        world->charPoint.x+=3;
+        world->charPoint.y-=3;
+        world->charDirection = PLAYER_DIR_RIGHT;
+    }
+    else if(!down && !right && left && !up)
+    {
+        world->charPoint.x-=3;
+        world->charPoint.y+=3;
+        world->charDirection = PLAYER_DIR_LEFT;
+    }
+    else if(down && !right && left && !up)
+    {
+        world->charPoint.y+=5;
+        world->charDirection = PLAYER_DIR_DOWN_LEFT;
+    }
+    else if(down && right && !left && !up)
+    {
+        world->charPoint.x+=5;
+        world->charDirection = PLAYER_DIR_DOWN_RIGHT;
+    }
+}
+
+void worldToggleGameMode(worldT *world)
+{
+    world->gameMode++;
+    if(world->gameMode>=NUM_GAME_MODES)
+    {
+        world->gameMode = GAME_MODE_OVERVIEW;
+    }
+}
+
+//positive direction zooms in, negative out, the camera stays on what it was looking at.
+//Below 1.0 the zoom halves and doubles so every step lands on a level of the LOD pyramid
+void worldZoom(worldT *world,int direction)
+{
+    float zoomLevel;
+
+    if(direction<0 && world->zoomLevel<=1.0){
+        zoomLevel = world->zoomLevel*0.5;
+    }
+    else if(direction>0 && world->zoomLevel<1.0){
+        zoomLevel = world->zoomLevel*2.0;
+    }
+    else{
+        zoomLevel = world->zoomLevel+(direction>0 ? WORLD_ZOOM_STEP : -WORLD_ZOOM_STEP);
+    }
+
+    if(zoomLevel<WORLD_MIN_ZOOM || zoomLevel>WORLD_MAX_ZOOM){
+        return;
+    }
+    world->zoomLevel = zoomLevel;
+    if(world->gameMode==GAME_MODE_OVERVIEW)
+    {
+        worldCenterMap(world,&world->tilePos);
+    }
+    if(world->gameMode == GAME_MODE_OBJECT_FOCUS){
+        worldCenterMap(world,&world->charPoint);
+    }
+}
+
+//a whole number of pixels in tiles, the fraction of a tile is kept
+static float pixelsToTiles(int pixels)
+{
+    return ISO_TILE_DIV(pixels) + ISO_TILE_MOD(pixels)/(float)TILESIZE;
+}
+
+void worldGetTileAtScreenPoint(worldT *world,point2DT *screenPoint,point2DT *tilePos)
+{
+    point2DT point;
+    point2DT tileShift, mouse2IsoPOint;
+    isoEngineT *isoEngine = &world->isoEngine;
+
+    if(screenPoint == NULL || tilePos == NULL){
+        return;
+    }
+
+    int modulusX = SDL_max(TILESIZE*world->zoomLevel,1);
+    int modulusY = SDL_max(TILESIZE*world->zoomLevel,1);
+    int correctX =(((int)world->mapScroll2Dpos.x)%modulusX)*2;
+    int correctY = ((int)world->mapScroll2Dpos.y)%modulusY;
+
+    //copy mouse point
+    mouse2IsoPOint = *screenPoint;
+    ConvertIsoTo2D(&mouse2IsoPOint);
+
+    //get tile coordinates
+    GetTileCoordinates(&mouse2IsoPOint,&point);
+
+    tileShift.x = correctX;
+    tileShift.y = correctY;
+    Convert2dToIso(&tileShift);
+
+    //check for fixing tile position when the y position is larger than 0
+    if(world->mapScroll2Dpos.y>0){
+        point.y -= pixelsToTiles(isoEngine->scrollY-(int)tileShift.y)/world->zoomLevel;
+        point.y+=1;
+    }
+    else{
+        point.y -= pixelsToTiles(isoEngine->scrollY-(int)tileShift.y)/world->zoomLevel;
+    }
+
+    //check for fixing tile position when the x position is larger than 0
+    if(world->mapScroll2Dpos.x>0)
+    {
+        point.x -= pixelsToTiles(isoEngine->scrollX+(int)tileShift.x)/world->zoomLevel;
+        point.x+=1;
+    }
+    else{
+        point.x -= pixelsToTiles(isoEngine->scrollX+(int)tileShift.x)/world->zoomLevel;
+    }
+    tilePos->x = (int)point.x;
+    tilePos->y = (int)point.y;
+}
+
+void worldCenterMapToTileAtScreenPoint(worldT *world,point2DT *screenPoint)
+{
+    point2DT mouseIsoTilePos;
+
+    //calculate the offset of the center of the screen
+    int offsetX = world->viewWidth/world->zoomLevel/2;
+    int offsetY = world->viewHeight/world->zoomLevel/2;
+
+    //get the tile under the mouse
+    worldGetTileAtScreenPoint(world,screenPoint,&mouseIsoTilePos);
+
+    world->tilePos.x = mouseIsoTilePos.x*TILESIZE;
+    world->tilePos.y = mouseIsoTilePos.y*TILESIZE;
+
+    //convert to isometric coordinates
+    Convert2dToIso(&mouseIsoTilePos);
+
+    //move the x position
+    world->mapScroll2Dpos.x = ((mouseIsoTilePos.x*TILESIZE)*world->zoomLevel)/2;
+    world->mapScroll2Dpos.x -= (offsetX*world->zoomLevel)/2;
+
+    //move the y position
+    world->mapScroll2Dpos.y = -((mouseIsoTilePos.y*TILESIZE)*world->zoomLevel);
+    world->mapScroll2Dpos.y += offsetY*world->zoomLevel;
+
+    //convert the map 2d camera to isometric camera
+    convertCartesianCameraToIsometric(&world->isoEngine,&world->mapScroll2Dpos);
+}
+
+void worldCenterMap(worldT *world,point2DT *objectPoint)
+{
+    point2DT pointPos = *objectPoint;
+
+    //calculate the offset of the center of the screen
+    int offsetX = world->viewWidth/world->zoomLevel/2;
+    int offsetY = world->viewHeight/world->zoomLevel/2;
+
+    world->tilePos.x = objectPoint->x;
+    world->tilePos.y = objectPoint->y;
+
+    Convert2dToIso(&pointPos);
+
+    world->mapScroll2Dpos.x = floor((pointPos.x)*world->zoomLevel)/2;
+    world->mapScroll2Dpos.x -= offsetX*world->zoomLevel/2;
+
+    if(world->gameMode == GAME_MODE_OBJECT_FOCUS){
+        world->mapScroll2Dpos.x +=45*world->zoomLevel/2;
+    }
+
+    world->mapScroll2Dpos.y = -floor((pointPos.y)*world->zoomLevel);
+    world->mapScroll2Dpos.y += offsetY*world->zoomLevel;
+
+    if(world->gameMode == GAME_MODE_OBJECT_FOCUS){
+        world->mapScroll2Dpos.y -= 51*world->zoomLevel;
+    }
+
+    convertCartesianCameraToIsometric(&world->isoEngine,&world->mapScroll2Dpos);
+}
+
+int worldSave(worldT *world)
+{
+    worldSaveStateT state;
+
+    state.charPoint = world->charPoint;
+    state.charDirection = world->charDirection;
+    state.mapScroll2Dpos = world->mapScroll2Dpos;
+    state.zoomLevel = world->zoomLevel;
+    state.gameMode = world->gameMode;
+    return mapStreamSave(&world->mapStream,&state,sizeof(state));
+}
+
+//only right after worldInit(...), before the map stream has loaded anything
+int worldLoad(worldT *world)
+{
+    worldSaveStateT state;
+
+    if(mapStreamLoadSave(&world->mapStream,&state,sizeof(state))==0){
+        return 0;
+    }
+    world->charPoint = state.charPoint;
+    world->charDirection = state.charDirection;
+    world->mapScroll2Dpos = state.mapScroll2Dpos;
+    world->zoomLevel = SDL_max(SDL_min(state.zoomLevel,WORLD_MAX_ZOOM),WORLD_MIN_ZOOM);
+    world->gameMode = state.gameMode>=0 && state.gameMode<NUM_GAME_MODES ? state.gameMode : GAME_MODE_OVERVIEW;
+    convertCartesianCameraToIsometric(&world->isoEngine,&world->mapScroll2Dpos);
+    return 1;
+}
+
+void worldClose(worldT *world)
+{
+    if(world == NULL){
+        return;
+    }
+    mapStreamClose(&world->mapStream);
+}
@@ -0,0 +1,71 @@
+#ifndef WORLD_H_
+#define WORLD_H_
+#include <SDL2/SDL.h>
+#include "isoEngine.h"
+#include "mapStream.h"
+
+#define PLAYER_DIR_UP_LEFT      0
+#define PLAYER_DIR_UP           1
+#define PLAYER_DIR_UP_RIGHT     2
+#define PLAYER_DIR_RIGHT        3
+#define PLAYER_DIR_DOWN_RIGHT   4
+#define PLAYER_DIR_DOWN         5
+#define PLAYER_DIR_DOWN_LEFT    6
+#define PLAYER_DIR_LEFT         7
+
+#define MAP_HEIGHT 8192
+#define MAP_WIDTH 8192
+
+#define GAME_MODE_OVERVIEW          0
+#define GAME_MODE_OBJECT_FOCUS      1
+#define NUM_GAME_MODES              2
+
+/*
+ *  What the player is doing this tick. The game fills it in from SDL, the headless
+ *  runner makes it up, the world itself never looks at a window or an event queue.
+ */
+typedef struct worldInputT
+{
+    int moveUp;
+    int moveDown;
+    int moveLeft;
+    int moveRight;
+    int hasMouse;
+    //mouse position in the window divided by the zoom level
+    int mouseX;
+    int mouseY;
+}worldInputT;
+
+typedef struct worldT
+{
+    isoEngineT isoEngine;
+    mapStreamT mapStream;
+    point2DT mapScroll2Dpos;
+    int mapScrolllSpeed;
+    float zoomLevel;
+    //the size of the screen the world is looked at through, in pixels
+    int viewWidth;
+    int viewHeight;
+    point2DT tilePos;
+    point2DT charPoint;
+    int charDirection;
+    int gameMode;
+    Uint32 numTicks;
+}worldT;
+
+int worldInit(worldT *world,int viewWidth,int viewHeight,int memoryBudgetInBytes,const char *directory);
+void worldStep(worldT *world,worldInputT *input);
+void worldUpdateCamera(worldT *world,worldInputT *input);
+void worldUpdateMapStream(worldT *world);
+void worldMoveCharacter(worldT *world,worldInputT *input);
+void worldToggleGameMode(worldT *world);
+void worldZoom(worldT *world,int direction);
+void worldGetViewRange(worldT *world,int *startX,int *startY,int *endX,int *endY);
+void worldGetTileAtScreenPoint(worldT *world,point2DT *screenPoint,point2DT *tilePos);
+void worldCenterMapToTileAtScreenPoint(worldT *world,point2DT *screenPoint);
+void worldCenterMap(worldT *world,point2DT *objectPoint);
+int worldSave(worldT *world);
+int worldLoad(worldT *world);
+void worldClose(worldT *world);
+
+#endif // WORLD_H_